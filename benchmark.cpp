@@ -0,0 +1,780 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cstring>
+#include <ctime>
+#include <thread>
+#include <atomic>
+#include "bintree.h"
+
+using namespace std;
+
+// Benchmark suite for bintree.h.
+//
+//   Binary_tree_bench [--max=N] [--draw-max=N] [--min-time=SECONDS] [--filter=TEXT] [--json=FILE]
+//
+// Every tree type is measured (build, insert, delete, find, lower_bound, metric queries,
+// drawGraph, drawView) for sizes 1e3, 1e4, ... up to --max (default 1e6, 1e7 at most)
+// on sorted, uniformly random, Zipf distributed and string keys, and so is CompactTree,
+// frozen from the AVLTree, in both of its layouts. Results are named
+// tree/operation/distribution/size, printed as a table and, with --json, written in the
+// layout of Google Benchmark's JSON reporter so the usual comparison scripts can read them.
+// The size results carry the bytes per node as a counter. drawGraph is also measured on
+// random trees of doubling sizes up to --draw-max, per key, which stays flat while
+// rendering is linear. ogdf::TreeLayout is measured on its own for random and path-shaped
+// trees and for forests of random trees, of the same sizes as the trees.
+
+struct Options
+{
+    int max_n = 1000000;
+    int draw_max = 100000;     // drawGraph goes through OGDF, which is far slower per node
+    int quadratic_max = 10000; // cap for operations that degenerate to O(n^2), RandomTree on sorted keys
+    double min_time = 0.1;     // seconds of measured time per benchmark
+    string filter;
+    string json;
+};
+
+struct Result
+{
+    string name;
+    long long iterations; // operations measured
+    double ns_per_op;
+    vector<pair<string, double>> counters; // reported next to the time, like Google Benchmark's user counters
+};
+
+static Options options;
+static vector<Result> results;
+
+// Runs setup() untimed and op(state) timed until min_time has been spent in op,
+// every run performs ops_per_run operations.
+template<class Setup, class Op>
+void run(const string &name, long long ops_per_run, Setup setup, Op op)
+{
+    if (!options.filter.empty() && name.find(options.filter) == string::npos)
+        return;
+
+    using clock = chrono::steady_clock;
+    auto spent = clock::duration::zero();
+    long long ops = 0;
+    do {
+        auto state = setup();
+        auto start = clock::now();
+        op(state);
+        spent += clock::now() - start;
+        ops += ops_per_run;
+    } while (chrono::duration<double>(spent).count() < options.min_time);
+
+    double ns = chrono::duration<double, nano>(spent).count() / ops;
+    results.push_back({name, ops, ns, {}});
+    cout << left << setw(64) << name << right << setw(14) << fixed << setprecision(1) << ns << " ns/op"
+         << setw(12) << ops << " ops" << endl;
+}
+
+// without setup, op() performs ops_per_run operations
+template<class Op>
+void run(const string &name, long long ops_per_run, Op op)
+{
+    run(name, ops_per_run, [] { return 0; }, [&](int) { op(); });
+}
+
+// attaches a counter to the result of the latest run, if that was name and not filtered out
+void counter(const string &name, const string &counter_name, double value)
+{
+    if (results.empty() || results.back().name != name)
+        return;
+
+    results.back().counters.emplace_back(counter_name, value);
+    cout << left << setw(64) << "  " + counter_name << right << setw(14) << fixed << setprecision(1) << value << endl;
+}
+
+// KEY DISTRIBUTIONS
+
+enum class Dist
+{
+    Sorted, // 0, 2, 4, ... in ascending order
+    Random, // the same keys shuffled
+    Zipf,   // ranks drawn with P(k) ~ 1/k, many repeats of few hot keys
+    String  // random 16 letter strings
+};
+
+const char *dist_name(Dist d)
+{
+    switch (d) {
+    case Dist::Sorted:
+        return "sorted";
+    case Dist::Random:
+        return "random";
+    case Dist::Zipf:
+        return "zipf";
+    default:
+        return "string";
+    }
+}
+
+vector<int> int_keys(Dist d, int n, mt19937 &gen)
+{
+    vector<int> keys(n);
+    if (d == Dist::Zipf) {
+        vector<double> cdf(n);
+        double total = 0;
+        for (int k = 0; k < n; k++)
+            cdf[k] = total += 1.0 / (k + 1);
+        uniform_real_distribution<double> u(0, total);
+        for (int &k : keys)
+            k = 2 * int(lower_bound(cdf.begin(), cdf.end(), u(gen)) - cdf.begin());
+        return keys;
+    }
+
+    for (int i = 0; i < n; i++)
+        keys[i] = 2 * i;
+    if (d == Dist::Random)
+        shuffle(keys.begin(), keys.end(), gen);
+    return keys;
+}
+
+vector<string> string_keys(int n, mt19937 &gen)
+{
+    uniform_int_distribution<int> letter('a', 'z');
+    vector<string> keys(n);
+    for (auto &k : keys) {
+        k.resize(16);
+        for (char &c : k)
+            c = char(letter(gen));
+    }
+    return keys;
+}
+
+// keys that are in none of the generated sets, for unsuccessful lookups
+int absent(int key)
+{
+    return key + 1;
+}
+
+string absent(const string &key)
+{
+    return key + "!";
+}
+
+// 4096 lookups of present keys interleaved with 4096 of absent ones
+template<class T>
+vector<T> lookup_probes(const vector<T> &keys, mt19937 &gen)
+{
+    vector<T> probes;
+    for (int i = 0; i < 4096; i++) {
+        const T &k = keys[gen() % keys.size()];
+        probes.push_back(k);
+        probes.push_back(absent(k));
+    }
+    return probes;
+}
+
+template<class T>
+vector<T> sorted_distinct(vector<T> keys)
+{
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+// occurrence counts as access frequencies
+template<class T>
+vector<pair<T, int64_t>> frequencies(const vector<T> &keys)
+{
+    vector<pair<T, int64_t>> f;
+    for (auto &k : sorted_distinct(keys))
+        f.emplace_back(k, 0);
+    for (auto &k : keys) {
+        auto it = lower_bound(f.begin(), f.end(), k, [](const pair<T, int64_t> &a, const T &b) {
+            return a.first < b;
+        });
+        it->second++;
+    }
+    return f;
+}
+
+// TREE BENCHMARKS
+
+template<class Tree, class T>
+void metric_benchmarks(const string &tree_name, const string &suffix, Tree &tree, int n, const vector<T> &probes)
+{
+    volatile long long sink = 0;
+    run(tree_name + "/find" + suffix, probes.size(), [&] {
+        for (auto &k : probes)
+            sink += tree.find(k) != nullptr;
+    });
+    run(tree_name + "/lower_bound" + suffix, probes.size(), [&] {
+        for (auto &k : probes)
+            sink += tree.lower_bound(k) != nullptr;
+    });
+#if SUBTREE_SIZES == 1
+    // without the sizes both walk the whole tree per call
+    run(tree_name + "/rank" + suffix, probes.size(), [&] {
+        for (auto &k : probes)
+            sink += tree.rank(k);
+    });
+    run(tree_name + "/select" + suffix, probes.size(), [&] {
+        int size = tree.size();
+        for (size_t i = 0; i < probes.size(); i++)
+            sink += tree.select(int(i * 7919 % size)) != nullptr;
+    });
+#endif
+    run(tree_name + "/size" + suffix, 1, [&] { sink += tree.size(); });
+    counter(tree_name + "/size" + suffix, "bytes_per_node", double(tree.memory_usage()) / max(1, tree.size()));
+    run(tree_name + "/tree_height" + suffix, 1, [&] { sink += tree.tree_height(); });
+    run(tree_name + "/average_height" + suffix, 1, [&] { sink += tree.average_height(); });
+    run(tree_name + "/control_sum" + suffix, 1, [&] { sink += tree.control_sum(); });
+    if (n <= options.draw_max)
+        run(tree_name + "/drawGraph" + suffix, 1, [&] { tree.drawGraph(); });
+    // a view of the same budget at every size; only AVLTree glyphs show heights, from its balance factors
+    run(tree_name + "/drawView" + suffix, 1, [&] {
+        typename Tree::View view;
+        view.nodes = 1000;
+        tree.drawView(view);
+    });
+}
+
+// CompactTree frozen from tree, under the names of the pointer trees' results to compare
+// with them; SplitKeys keeps the keys apart from the links (CompactTree), otherwise next
+// to them (CompactTreeAoS)
+template<bool SplitKeys, class T>
+void bench_compact(const string &suffix, const BinTree<T> &tree, const vector<T> &probes)
+{
+    string name = SplitKeys ? "CompactTree" : "CompactTreeAoS";
+    volatile long long sink = 0;
+
+    run(name + "/build" + suffix, tree.size(), [&] { CompactTree<T, SplitKeys> compact(tree); });
+
+    CompactTree<T, SplitKeys> compact(tree);
+    run(name + "/find" + suffix, probes.size(), [&] {
+        for (auto &k : probes)
+            sink += compact.contains(k);
+    });
+    run(name + "/size" + suffix, 1, [&] { sink += compact.size(); });
+    counter(name + "/size" + suffix, "bytes_per_node", double(compact.memory_usage()) / max(1, compact.size()));
+    run(name + "/tree_height" + suffix, 1, [&] { sink += compact.tree_height(); });
+    run(name + "/average_height" + suffix, 1, [&] { sink += compact.average_height(); });
+    run(name + "/control_sum" + suffix, 1, [&] { sink += compact.control_sum(); });
+    run(name + "/height_and_sum" + suffix, 1, [&] { sink += compact.tree_height() + compact.control_sum(); });
+}
+
+template<class T>
+void bench_ideal(const string &suffix, const vector<T> &keys, const vector<T> &probes)
+{
+    vector<T> sorted = sorted_distinct(keys);
+    int n = int(keys.size());
+
+    run("IdealTree/build" + suffix, sorted.size(), [&] { IdealTree<T> tree(sorted, "bench.svg"); });
+
+    IdealTree<T> tree(sorted, "bench.svg");
+    metric_benchmarks("IdealTree", suffix, tree, n, probes);
+}
+
+template<class T>
+void bench_random(const string &suffix, const vector<T> &keys, const vector<T> &probes, bool degenerate)
+{
+    int n = int(keys.size());
+    int half = n / 2;
+    vector<T> first(keys.begin(), keys.begin() + half), second(keys.begin() + half, keys.end());
+    bool quadratic = degenerate && n > options.quadratic_max;
+
+    run("RandomTree/build" + suffix, n, [&] { RandomTree<T> tree(keys, "bench.svg"); });
+
+    if (!quadratic) {
+        run("RandomTree/insert" + suffix, n - half,
+            [&] { return make_unique<RandomTree<T>>(first, "bench.svg"); },
+            [&](unique_ptr<RandomTree<T>> &tree) {
+                for (auto &k : second)
+                    tree->addElem(k);
+            });
+
+        run("RandomTree/delete" + suffix, n,
+            [&] { return make_unique<RandomTree<T>>(keys, "bench.svg"); },
+            [&](unique_ptr<RandomTree<T>> &tree) {
+                for (auto &k : keys)
+                    tree->deleteElem(k);
+            });
+
+        RandomTree<T> tree(keys, "bench.svg");
+        metric_benchmarks("RandomTree", suffix, tree, n, probes);
+    }
+}
+
+// Lookups through AVLTree::Reader on 1, 2, 4, ... threads while one writer keeps inserting
+// and deleting the second half of the keys, ops are lookups of all threads together
+template<class T>
+void bench_concurrent_find(const string &suffix, const vector<T> &first, const vector<T> &second, const vector<T> &probes)
+{
+    AVLTree<T> tree(first, "bench.svg");
+    tree.concurrent_reads(true);
+    unsigned hardware = max(1u, thread::hardware_concurrency());
+    atomic<long long> sink{0};
+
+    for (unsigned threads = 1; threads <= hardware; threads *= 2) {
+        string name = "AVLTree/concurrent_find" + suffix + "/threads:" + to_string(threads);
+        if (!options.filter.empty() && name.find(options.filter) == string::npos)
+            continue;
+
+        atomic<bool> stop{false};
+        thread writer([&] {
+            for (size_t i = 0; !stop; i = (i + 1) % second.size()) {
+                tree.addElem(second[i]);
+                tree.deleteElem(second[i]);
+            }
+        });
+        run(name, probes.size() * threads, [&] {
+            vector<thread> readers;
+            for (unsigned t = 0; t < threads; t++) {
+                readers.emplace_back([&] {
+                    long long found = 0;
+                    for (auto &k : probes) {
+                        typename AVLTree<T>::Reader reader(tree);
+                        found += reader.find(k) != nullptr;
+                    }
+                    sink += found;
+                });
+            }
+            for (auto &r : readers)
+                r.join();
+        });
+        stop = true;
+        writer.join();
+    }
+}
+
+// Snapshot::statistics and Snapshot::drawGraph on 1, 2, 4, ... threads while one writer keeps
+// inserting and deleting the second half of the keys, every thread takes its own snapshots;
+// ops are snapshots of all threads together. Each thread draws to a file of its own.
+template<class T>
+void bench_concurrent_snapshot(const string &suffix, const vector<T> &first, const vector<T> &second, int n)
+{
+    AVLTree<T> tree(first, "bench.svg");
+    tree.concurrent_reads(true);
+    unsigned hardware = max(1u, thread::hardware_concurrency());
+    atomic<long long> sink{0};
+
+    for (bool draw : {false, true}) {
+        if (draw && n > options.draw_max)
+            continue;
+        // a statistics walk is short next to starting the threads
+        int per_thread = draw ? 1 : 16;
+
+        for (unsigned threads = 1; threads <= hardware; threads *= 2) {
+            string name = string("AVLTree/concurrent_snapshot_") + (draw ? "drawGraph" : "statistics")
+                + suffix + "/threads:" + to_string(threads);
+            if (!options.filter.empty() && name.find(options.filter) == string::npos)
+                continue;
+
+            atomic<bool> stop{false};
+            thread writer([&] {
+                for (size_t i = 0; !stop; i = (i + 1) % second.size()) {
+                    tree.addElem(second[i]);
+                    tree.deleteElem(second[i]);
+                }
+            });
+            run(name, per_thread * threads, [&] {
+                vector<thread> readers;
+                for (unsigned t = 0; t < threads; t++) {
+                    readers.emplace_back([&, t] {
+                        string filename = "bench_snapshot" + to_string(t) + ".svg";
+                        for (int i = 0; i < per_thread; i++) {
+                            typename AVLTree<T>::Snapshot snapshot(tree);
+                            if (draw)
+                                snapshot.drawGraph(filename);
+                            else
+                                sink += snapshot.statistics().size;
+                        }
+                    });
+                }
+                for (auto &r : readers)
+                    r.join();
+            });
+            stop = true;
+            writer.join();
+        }
+    }
+}
+
+#if DIRECT_LAYOUT == 1
+// drawGraph after every 8 inserts or deletes of keys of the second half, laid out afresh and
+// with the layout kept between calls (incremental_drawing), ops are drawGraph calls; the
+// incremental result carries the speedup over the fresh one as a counter
+template<class T>
+void bench_incremental_draw(const string &suffix, const vector<T> &first, const vector<T> &second)
+{
+    if (second.empty())
+        return;
+
+    double fresh_ns = 0;
+    for (bool incremental : {false, true}) {
+        string name = string("AVLTree/drawGraph_") + (incremental ? "incremental" : "fresh") + suffix;
+        if (!options.filter.empty() && name.find(options.filter) == string::npos)
+            continue;
+
+        AVLTree<T> tree(first, "bench.svg");
+        tree.incremental_drawing(incremental);
+        tree.drawGraph();
+
+        // the same keys go in and come out again in both runs
+        size_t window = 0;
+        bool inserted = false;
+        run(name, 1,
+            [&] {
+                for (size_t i = 0; i < 8; i++) {
+                    const T &k = second[(window + i) % second.size()];
+                    if (inserted)
+                        tree.deleteElem(k);
+                    else
+                        tree.addElem(k);
+                }
+                if (inserted)
+                    window += 8;
+                inserted = !inserted;
+                return 0;
+            },
+            [&](int) { tree.drawGraph(); });
+
+        if (results.back().name != name)
+            continue;
+        if (!incremental)
+            fresh_ns = results.back().ns_per_op;
+        else if (fresh_ns > 0)
+            counter(name, "speedup", fresh_ns / results.back().ns_per_op);
+    }
+}
+#endif
+
+template<class T>
+void bench_avl(const string &suffix, const vector<T> &keys, const vector<T> &probes)
+{
+    using Load = typename AVLTree<T>::Load;
+    int n = int(keys.size());
+    int half = n / 2;
+    vector<T> first(keys.begin(), keys.begin() + half), second(keys.begin() + half, keys.end());
+    vector<T> distinct = sorted_distinct(keys);
+
+    run("AVLTree/build" + suffix, n, [&] { AVLTree<T> tree(keys, "bench.svg"); });
+    run("AVLTree/build_bulk" + suffix, n, [&] { AVLTree<T> tree(keys, "bench.svg", Load::Bulk); });
+    if (thread::hardware_concurrency() > 1)
+        run("AVLTree/build_parallel" + suffix, n, [&] { AVLTree<T> tree(keys, "bench.svg", Load::ParallelBulk); });
+
+    run("AVLTree/insert" + suffix, n - half,
+        [&] { return make_unique<AVLTree<T>>(first, "bench.svg"); },
+        [&](unique_ptr<AVLTree<T>> &tree) {
+            for (auto &k : second)
+                tree->addElem(k);
+        });
+
+    run("AVLTree/delete" + suffix, distinct.size(),
+        [&] { return make_unique<AVLTree<T>>(keys, "bench.svg"); },
+        [&](unique_ptr<AVLTree<T>> &tree) {
+            for (auto &k : distinct)
+                tree->deleteElem(k);
+        });
+
+    run("AVLTree/insert_batch" + suffix, n - half,
+        [&] { return make_unique<AVLTree<T>>(first, "bench.svg"); },
+        [&](unique_ptr<AVLTree<T>> &tree) { tree->insert_batch(second); });
+
+    run("AVLTree/erase_batch" + suffix, distinct.size(),
+        [&] { return make_unique<AVLTree<T>>(keys, "bench.svg"); },
+        [&](unique_ptr<AVLTree<T>> &tree) { tree->erase_batch(distinct); });
+
+    // set operations of the trees over both halves of the keys
+    AVLTree<T> other(second, "bench.svg");
+    run("AVLTree/set_union" + suffix, n,
+        [&] { return make_unique<AVLTree<T>>(first, "bench.svg"); },
+        [&](unique_ptr<AVLTree<T>> &tree) { tree->set_union(other); });
+    run("AVLTree/set_intersection" + suffix, n,
+        [&] { return make_unique<AVLTree<T>>(first, "bench.svg"); },
+        [&](unique_ptr<AVLTree<T>> &tree) { tree->set_intersection(other); });
+    run("AVLTree/set_difference" + suffix, n,
+        [&] { return make_unique<AVLTree<T>>(first, "bench.svg"); },
+        [&](unique_ptr<AVLTree<T>> &tree) { tree->set_difference(other); });
+
+    AVLTree<T> tree(keys, "bench.svg");
+    metric_benchmarks("AVLTree", suffix, tree, n, probes);
+#if DIRECT_LAYOUT == 1
+    if (n <= options.draw_max)
+        bench_incremental_draw(suffix, first, second);
+#endif
+
+    // the walk behind the metric queries, which the tree caches but a Snapshot does again on
+    // every call, against the sweeps of CompactTree
+    volatile long long sink = 0;
+    tree.concurrent_reads(true);
+    run("AVLTree/height_and_sum" + suffix, 1, [&] {
+        typename AVLTree<T>::Snapshot snapshot(tree);
+        auto st = snapshot.statistics();
+        sink += st.height + st.control_sum;
+    });
+    tree.concurrent_reads(false);
+    bench_compact<true>(suffix, tree, probes);
+    bench_compact<false>(suffix, tree, probes);
+    bench_concurrent_find(suffix, first, second, probes);
+    if (!second.empty())
+        bench_concurrent_snapshot(suffix, first, second, n);
+}
+
+template<class T>
+void bench_optimal(const string &suffix, const vector<T> &keys, const vector<T> &probes, bool degenerate)
+{
+    using Method = typename OptimalTree<T>::Method;
+    auto weighted = frequencies(keys);
+    int n = int(keys.size());
+    int half = n / 2;
+    vector<T> first(keys.begin(), keys.begin() + half), second(keys.begin() + half, keys.end());
+    auto weighted_first = frequencies(first);
+
+    if (weighted.size() <= OPTIMAL_EXACT_LIMIT)
+        run("OptimalTree/build_exact" + suffix, weighted.size(), [&] {
+            OptimalTree<T> tree(weighted, "bench.svg", Method::Exact);
+        });
+    run("OptimalTree/build_approximate" + suffix, weighted.size(), [&] {
+        OptimalTree<T> tree(weighted, "bench.svg", Method::Approximate);
+    });
+
+    // the updates are RandomTree's, sorted keys appended to the first half build a path
+    if (!(degenerate && n > options.quadratic_max))
+        run("OptimalTree/insert" + suffix, n - half,
+            [&] { return make_unique<OptimalTree<T>>(weighted_first, "bench.svg"); },
+            [&](unique_ptr<OptimalTree<T>> &tree) {
+                for (auto &k : second)
+                    tree->addElem(k);
+            });
+
+    run("OptimalTree/delete" + suffix, n,
+        [&] { return make_unique<OptimalTree<T>>(weighted, "bench.svg"); },
+        [&](unique_ptr<OptimalTree<T>> &tree) {
+            for (auto &k : keys)
+                tree->deleteElem(k);
+        });
+
+    OptimalTree<T> tree(weighted, "bench.svg");
+    metric_benchmarks("OptimalTree", suffix, tree, n, probes);
+}
+
+template<class T>
+void bench_all(Dist d, const vector<T> &keys, mt19937 &gen)
+{
+    string suffix = string("/") + dist_name(d) + "/" + to_string(keys.size());
+    vector<T> probes = lookup_probes(keys, gen);
+    bench_ideal(suffix, keys, probes);
+    bench_random(suffix, keys, probes, d == Dist::Sorted);
+    bench_avl(suffix, keys, probes);
+    bench_optimal(suffix, keys, probes, d == Dist::Sorted);
+}
+
+// drawGraph of random trees of 1000, 2000, 4000, ... keys up to --draw-max, ops are keys
+void bench_draw_scaling(mt19937 &gen)
+{
+    for (int n = 1000; n <= options.draw_max; n *= 2) {
+        string name = "RandomTree/drawGraph_scaling/random/" + to_string(n);
+        if (!options.filter.empty() && name.find(options.filter) == string::npos)
+            continue;
+
+        vector<int> keys(n);
+        for (int &k : keys)
+            k = gen();
+        RandomTree<int> tree(keys, "bench.svg");
+        run(name, n, [&] { tree.drawGraph(); });
+    }
+}
+
+// TREE LAYOUT
+
+enum class TreeShape
+{
+    Random, // parent of every node drawn uniformly from the nodes before it, wide and shallow
+    Path,   // every node the only child of the one before it, as deep as possible
+    Forest  // random trees of 1000 nodes each, laid out on all hardware threads
+};
+
+const char *shape_name(TreeShape shape)
+{
+    switch (shape) {
+    case TreeShape::Random:
+        return "random";
+    case TreeShape::Path:
+        return "path";
+    default:
+        return "forest";
+    }
+}
+
+// ogdf::TreeLayout::call on a tree of n nodes, ops are nodes laid out
+void bench_tree_layout(TreeShape shape, int n, mt19937 &gen)
+{
+    string name = string("TreeLayout/") + shape_name(shape) + "/" + to_string(n);
+    if (!options.filter.empty() && name.find(options.filter) == string::npos)
+        return;
+
+    Graph G;
+    GraphAttributes GA(G, GraphAttributes::nodeGraphics | GraphAttributes::edgeGraphics);
+    vector<node> nodes(n);
+    for (int i = 0; i < n; i++) {
+        nodes[i] = G.newNode();
+        int first = shape == TreeShape::Forest ? i / 1000 * 1000 : 0; // root of the tree of node i
+        if (i > first) {
+            int parent = shape == TreeShape::Path ? i - 1 : uniform_int_distribution<int>(first, i - 1)(gen);
+            G.newEdge(nodes[parent], nodes[i]);
+        }
+    }
+
+    TreeLayout layout;
+    run(name, n, [&] { layout.call(GA); });
+}
+
+// OUTPUT
+
+void write_json(const string &filename)
+{
+    ofstream out(filename);
+    time_t now = time(nullptr);
+    char date[64];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+    out << "{\n"
+        << "  \"context\": {\n"
+        << "    \"date\": \"" << date << "\",\n"
+        << "    \"num_cpus\": " << thread::hardware_concurrency() << ",\n"
+#ifdef NDEBUG
+        << "    \"library_build_type\": \"release\",\n"
+#else
+        << "    \"library_build_type\": \"debug\",\n"
+#endif
+        << "    \"leaf_slab_size\": " << LEAF_SLAB_SIZE << ",\n"
+        << "    \"subtree_sizes\": " << SUBTREE_SIZES << "\n"
+        << "  },\n"
+        << "  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        out << "    {\n"
+            << "      \"name\": \"" << r.name << "\",\n"
+            << "      \"run_type\": \"iteration\",\n"
+            << "      \"iterations\": " << r.iterations << ",\n"
+            << "      \"real_time\": " << setprecision(6) << r.ns_per_op << ",\n"
+            << "      \"cpu_time\": " << r.ns_per_op << ",\n"
+            << "      \"time_unit\": \"ns\"";
+        for (auto &c : r.counters)
+            out << ",\n      \"" << c.first << "\": " << c.second;
+        out << "\n    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+bool parse_option(const char *arg, const char *name, string &value)
+{
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) != 0 || arg[len] != '=')
+        return false;
+    value = arg + len + 1;
+    return true;
+}
+
+// CONSISTENCY CHECKS
+
+string file_contents(const string &filename)
+{
+    ifstream in(filename);
+    stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+// Cases where a cached result once went stale; the suite refuses to measure a build that
+// gets them wrong. Returns the number of failed checks.
+int consistency_checks()
+{
+    int failed = 0;
+    auto check = [&failed](bool ok, const char *what) {
+        if (!ok) {
+            cerr << "consistency check failed: " << what << endl;
+            failed++;
+        }
+    };
+
+    // deleting the last key in concurrent mode only retires the leaf and empties the root
+    AVLTree<int> tree({5}, "bench.svg");
+    check(tree.statistics().size == 1, "statistics before the concurrent delete");
+    tree.concurrent_reads(true);
+    tree.deleteElem(5);
+    auto st = tree.statistics();
+    check(tree.size() == 0 && st.size == 0, "size after the concurrent delete to empty");
+    check(st.height == 0 && st.path_length == 0 && st.control_sum == 0,
+          "statistics after the concurrent delete to empty");
+    tree.concurrent_reads(false);
+
+#if DIRECT_LAYOUT == 1
+    // a kept drawing, laid out again only where the updates went, is written like a fresh one
+    mt19937 gen(7);
+    vector<int> keys(2000);
+    for (int &k : keys)
+        k = int(gen() % 4000);
+    AVLTree<int> drawn(keys, "bench.svg");
+    drawn.incremental_drawing(true);
+    drawn.drawGraph();
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < 50; i++) {
+            int k = int(gen() % 4000);
+            if (gen() % 2)
+                drawn.addElem(k);
+            else
+                drawn.deleteElem(k);
+        }
+        drawn.drawGraph();
+        string incremental = file_contents("bench.svg");
+        drawn.incremental_drawing(false);
+        drawn.drawGraph();
+        check(file_contents("bench.svg") == incremental, "incremental drawGraph against a fresh one");
+        drawn.incremental_drawing(true);
+        drawn.drawGraph();
+    }
+#endif
+    return failed;
+}
+
+int main(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++) {
+        string value;
+        if (parse_option(argv[i], "--max", value))
+            options.max_n = min(stoi(value), 10000000);
+        else if (parse_option(argv[i], "--draw-max", value))
+            options.draw_max = stoi(value);
+        else if (parse_option(argv[i], "--min-time", value))
+            options.min_time = stod(value);
+        else if (parse_option(argv[i], "--filter", value))
+            options.filter = value;
+        else if (parse_option(argv[i], "--json", value))
+            options.json = value;
+        else {
+            cerr << "usage: " << argv[0]
+                 << " [--max=N] [--draw-max=N] [--min-time=SECONDS] [--filter=TEXT] [--json=FILE]" << endl;
+            return 1;
+        }
+    }
+
+    if (consistency_checks() != 0)
+        return 1;
+
+    mt19937 gen(42);
+    for (int n = 1000; n <= options.max_n; n *= 10) {
+        for (Dist d : {Dist::Sorted, Dist::Random, Dist::Zipf})
+            bench_all(d, int_keys(d, n, gen), gen);
+        bench_all(Dist::String, string_keys(n, gen), gen);
+        bench_tree_layout(TreeShape::Random, n, gen);
+        bench_tree_layout(TreeShape::Path, n, gen);
+        bench_tree_layout(TreeShape::Forest, n, gen);
+    }
+    bench_draw_scaling(gen);
+
+    if (!options.json.empty())
+        write_json(options.json);
+
+    return 0;
+}
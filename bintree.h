@@ -1,43 +1,398 @@
 #ifndef BINARY_TREE_BINTREE_H
 #define BINARY_TREE_BINTREE_H
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include <algorithm>
 #include <iomanip>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+#include <charconv>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <string_view>
 #include <ogdf/basic/Graph.h>
 #include <ogdf/fileformats/GraphIO.h>
+#include <ogdf/fileformats/SvgPrinter.h>
 #include <ogdf/tree/TreeLayout.h>
 #include <ogdf/layered/SugiyamaLayout.h>
 
 #define NULL_RENDER 1
+#define DIRECT_LAYOUT 1 // 0 lays drawGraph output out through an OGDF Graph and TreeLayout
+#define LEAF_SLAB_SIZE 4096 // leaves per arena slab, 0 allocates every leaf from the OGDF pool
+#define PARALLEL_CUTOFF 65536 // smaller inputs are never split between threads
+#define SUBTREE_SIZES 1 // 0 leaves the subtree size out of Leaf, size(), rank() and select() then walk the tree
 
 using namespace ogdf;
 
+#if LEAF_SLAB_SIZE > 0
+// Slab allocator for tree nodes. Nodes are carved out of contiguous slabs of
+// LEAF_SLAB_SIZE elements, erased nodes are kept on a free list for reuse and
+// the whole tree is torn down slab by slab.
+//
+// Every slot below the fill mark of a slab stays constructed, free ones included,
+// so release() only has to run destructors when Node is not trivially destructible.
+//
+// allocate_block() hands out a contiguous run of raw slots for bulk builds, the
+// caller has to construct all of them before the arena is released.
+template<class Node>
+class NodeArena
+{
+public:
+    NodeArena() = default;
+    NodeArena(const NodeArena &) = delete;
+    NodeArena &operator=(const NodeArena &) = delete;
+
+    ~NodeArena()
+    {
+        release();
+    }
+
+    template<class... Args>
+    Node *create(Args &&... args);
+
+    void destroy(Node *p);
+    void release();
+
+    Node *allocate_block(size_t n);
+
+    // bytes reserved by the slabs
+    size_t bytes() const
+    {
+        return (slabs.size() * LEAF_SLAB_SIZE + block_slots) * sizeof(Node);
+    }
+
+    // nodes handed out and not destroyed yet
+    size_t live() const
+    {
+        return count;
+    }
+
+private:
+    std::vector<Node *> slabs;
+    int used = LEAF_SLAB_SIZE; // constructed slots of the last slab
+    Node *free_list = nullptr; // linked through Node::left
+    size_t count = 0;
+    std::vector<std::pair<Node *, size_t>> blocks;
+    size_t block_slots = 0;
+};
+
+template<class Node>
+template<class... Args>
+Node *NodeArena<Node>::create(Args &&... args)
+{
+    Node *p;
+    if (free_list != nullptr) {
+        p = free_list;
+        free_list = p->left;
+        p->~Node();
+    }
+    else {
+        if (used == LEAF_SLAB_SIZE) {
+            slabs.push_back(static_cast<Node *>(::operator new(sizeof(Node) * LEAF_SLAB_SIZE)));
+            used = 0;
+        }
+        p = slabs.back() + used++;
+    }
+    ++count;
+    return new(p) Node(std::forward<Args>(args)...);
+}
+
+template<class Node>
+void NodeArena<Node>::destroy(Node *p)
+{
+    p->left = free_list;
+    free_list = p;
+    --count;
+}
+
+template<class Node>
+Node *NodeArena<Node>::allocate_block(size_t n)
+{
+    Node *p = static_cast<Node *>(::operator new(sizeof(Node) * n));
+    blocks.emplace_back(p, n);
+    block_slots += n;
+    count += n;
+    return p;
+}
+
+template<class Node>
+void NodeArena<Node>::release()
+{
+    for (size_t i = 0; i < slabs.size(); i++) {
+        if (!std::is_trivially_destructible<Node>::value) {
+            int constructed = i + 1 < slabs.size() ? LEAF_SLAB_SIZE : used;
+            for (int j = 0; j < constructed; j++)
+                slabs[i][j].~Node();
+        }
+        ::operator delete(slabs[i]);
+    }
+    for (auto &b : blocks) {
+        if (!std::is_trivially_destructible<Node>::value) {
+            for (size_t j = 0; j < b.second; j++)
+                b.first[j].~Node();
+        }
+        ::operator delete(b.first);
+    }
+    slabs.clear();
+    blocks.clear();
+    block_slots = 0;
+    used = LEAF_SLAB_SIZE;
+    free_list = nullptr;
+    count = 0;
+}
+#endif
+
+// Sorts v with one std::sort per hardware thread and merges the runs pairwise,
+// the merges of one round running in parallel as well.
+template<class T>
+void parallel_sort(std::vector<T> &v)
+{
+    size_t chunks = std::thread::hardware_concurrency();
+    if (chunks < 2 || v.size() < PARALLEL_CUTOFF) {
+        std::sort(v.begin(), v.end());
+        return;
+    }
+
+    std::vector<size_t> bounds(chunks + 1);
+    for (size_t i = 0; i <= chunks; i++)
+        bounds[i] = v.size() * i / chunks;
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < chunks; i++) {
+        workers.emplace_back([&v, lo = bounds[i], hi = bounds[i + 1]] {
+            std::sort(v.begin() + lo, v.begin() + hi);
+        });
+    }
+    for (auto &w : workers)
+        w.join();
+
+    for (size_t width = 1; width < chunks; width *= 2) {
+        workers.clear();
+        for (size_t i = 0; i + width < chunks; i += 2 * width) {
+            size_t lo = bounds[i], mid = bounds[i + width], hi = bounds[std::min(i + 2 * width, chunks)];
+            workers.emplace_back([&v, lo, mid, hi] {
+                std::inplace_merge(v.begin() + lo, v.begin() + mid, v.begin() + hi);
+            });
+        }
+        for (auto &w : workers)
+            w.join();
+    }
+}
+
+// Key policy of the trees: format() labels a leaf in drawings, compare() orders keys three-way
+// and sum() is what a key adds to the control sum, its value for numbers and the low 32 bits
+// of hash() otherwise, so that sums of up to 2^31 keys cannot overflow. The general template
+// needs operator<, operator<< and std::hash, specialize it for keys that lack them. Searches
+// and updates compare through it; the bulk loads and batch operations sort the keys with
+// operator< and still need it.
+//
+// Prefix is the part of a key that every leaf keeps next to it. Comparing the prefixes first
+// settles most comparisons without touching the key, the general one is empty and settles none.
+template<class T>
+struct KeyTraits
+{
+    struct Prefix
+    {
+        explicit Prefix(const T &)
+        {}
+
+        int compare(const Prefix &) const
+        {
+            return 0;
+        }
+    };
+
+    static int compare(const T &a, const T &b)
+    {
+        return a < b ? -1 : (b < a ? 1 : 0);
+    }
+
+    static size_t hash(const T &key)
+    {
+        return std::hash<T>()(key);
+    }
+
+    static std::string format(const T &key)
+    {
+        if constexpr(std::is_arithmetic<T>::value) {
+            char buf[32];
+            return std::string(buf, std::to_chars(buf, buf + sizeof(buf), key).ptr);
+        }
+        else {
+            std::ostringstream os;
+            os << key;
+            return os.str();
+        }
+    }
+
+    static int64_t sum(const T &key)
+    {
+        if constexpr(std::is_arithmetic<T>::value)
+            return static_cast<int64_t>(key);
+        else
+            return static_cast<int64_t>(hash(key) & 0xffffffff);
+    }
+};
+
+// Strings are compared through string_view, which never allocates, and their prefix is the
+// first eight bytes packed big-endian and padded with zeros. Prefixes that differ then order
+// the same way as the strings, equal ones leave the decision to the whole strings.
+template<>
+struct KeyTraits<std::string>
+{
+    struct Prefix
+    {
+        explicit Prefix(std::string_view key)
+        {
+            unsigned char b[8] = {};
+            std::memcpy(b, key.data(), std::min<size_t>(key.size(), sizeof(b)));
+            for (unsigned char c : b)
+                bytes = bytes << 8 | c;
+        }
+
+        int compare(const Prefix &other) const
+        {
+            return (bytes > other.bytes) - (bytes < other.bytes);
+        }
+
+        uint64_t bytes = 0;
+    };
+
+    static int compare(std::string_view a, std::string_view b)
+    {
+        return a.compare(b);
+    }
+
+    static size_t hash(std::string_view key)
+    {
+        return std::hash<std::string_view>()(key);
+    }
+
+    static std::string format(const std::string &key)
+    {
+        return key;
+    }
+
+    static int64_t sum(std::string_view key)
+    {
+        return static_cast<int64_t>(hash(key) & 0xffffffff);
+    }
+};
+
 template<class T>
 class BinTree
 {
 public:
+    BinTree() = default;
+    BinTree(const BinTree &) = delete;
+    BinTree &operator=(const BinTree &) = delete;
+
+    class Leaf;
+
+    ~BinTree()
+    {
+        release_leaves();
+    }
+
+    // everything the metric queries report, gathered in one walk
+    struct Statistics
+    {
+        int size = 0;
+        int height = 0;
+        int64_t path_length = 0; // sum of the levels of all leaves, the root is on level 1
+        int64_t control_sum = 0;
+    };
+
     void print();
 
+    // The walk is done again only after the tree has changed since the last one, monitoring
+    // an idle tree costs a lock.
+    Statistics statistics() const
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        // cleared before the walk, a change during it marks the result stale again
+        if (stats_dirty.exchange(false))
+            stats = statistics_from(this->root);
+        return stats;
+    }
+
     int size() const
     {
-        return tree_size(this->root);
+#if SUBTREE_SIZES == 1
+        return size_of(this->root);
+#else
+        return statistics().size;
+#endif
     }
 
     int tree_height() const
     {
-        return get_tree_height(this->root);
+        return statistics().height;
     }
 
     int average_height() const
     {
-        return get_average_height(this->root, 1) / size();
+        Statistics st = statistics();
+        return st.size == 0 ? 0 : static_cast<int>(st.path_length / st.size);
+    }
+
+    int64_t control_sum() const
+    {
+        return statistics().control_sum;
+    }
+
+    // leaf holding key, nullptr if there is none
+    const Leaf *find(const T &key) const
+    {
+        return find_from(this->root, key);
+    }
+
+    bool contains(const T &key) const
+    {
+        return find(key) != nullptr;
+    }
+
+    // leaf with the smallest key not less than key, nullptr if every key is less
+    const Leaf *lower_bound(const T &key) const
+    {
+        return lower_bound_from(this->root, key);
+    }
+
+    // leaf with the smallest key greater than key, nullptr if there is none
+    const Leaf *upper_bound(const T &key) const
+    {
+        return upper_bound_from(this->root, key);
+    }
+
+    // number of keys in [lo, hi)
+    int count_range(const T &lo, const T &hi) const
+    {
+        return count_range_from(this->root, lo, hi);
     }
 
-    int control_sum() const
+    // number of keys less than key
+    int rank(const T &key) const
     {
-        return get_control_sum(this->root);
+        return rank_from(this->root, key);
+    }
+
+    // leaf with the k-th smallest key, counting from 0, nullptr if there are not that many
+    const Leaf *select(int k) const
+    {
+        return select_from(this->root, k);
+    }
+
+    // Calls visit(leaf, level) for every leaf in preorder, the root is on level 1.
+    // The walk keeps its own stack, so degenerate trees cannot overflow the call stack.
+    template<class Visitor>
+    void traverse(Visitor visit) const
+    {
+        traverse_from(this->root, visit);
     }
 
     void drawGraph()
@@ -45,46 +400,343 @@ public:
         draw_graph(this->root);
     }
 
-protected:
+    // Keeps the layout between drawGraph calls. Inserts and deletes then mark the leaves they
+    // change and the next drawGraph lays out again only those and their ancestors; writing
+    // the file still takes time linear in the size of the tree. Needs DIRECT_LAYOUT.
+    void incremental_drawing(bool enable);
+
+    // what drawView() shows of the tree
+    struct View
+    {
+        const Leaf *root = nullptr; // subtree in view, e.g. from find(), the whole tree if nullptr
+        int depth = 0;              // levels drawn, root on level 1, 0 for all
+        int nodes = 0;              // leaves drawn at most, level by level from the root, 0 for all
+        double scale = 1;           // pixels per unit of the layout on screen
+        double min_pixels = 0;      // subtrees estimated narrower on screen are collapsed, needs SUBTREE_SIZES
+        bool heights = false;       // glyphs show heights too, which takes a walk of every collapsed subtree
+    };
+
+    // Level-of-detail drawing for trees too big to draw whole. Leaves the view leaves out are
+    // drawn as one glyph per subtree with its number of leaves and height, NULL nodes are not
+    // drawn at all, so layout and file grow with the view and not with the tree.
+    void drawView(const View &view) const
+    {
+        draw_view(view, [](const Leaf *p) { return statistics_from(p).height; });
+    }
+
+    // bytes held by the leaves of the tree
+    size_t memory_usage() const;
+
     class Leaf
     {
+#if LEAF_SLAB_SIZE == 0
+        OGDF_NEW_DELETE
+#endif
     public:
         Leaf(const T &buf, int data_index)
+            : prefix(buf), data(buf)
         {
-            data = buf;
             index = data_index;
             Bal = 0;
         }
 
-        Leaf *left;
-        Leaf *right;
+        Leaf *left = nullptr;
+        Leaf *right = nullptr;
         int Bal;
+        typename KeyTraits<T>::Prefix prefix; // kept in step with data
         T data;
         int index = 0;
+        int slot = -1; // slot in the kept drawing
+#if SUBTREE_SIZES == 1
+        int size = 1; // leaves in the subtree of this one
+#endif
+    };
+
+protected:
+    Leaf *root = nullptr;
+
+    // a key with its prefix worked out once for all the comparisons of a search
+    struct Probe
+    {
+        explicit Probe(const T &key)
+            : key(key), prefix(key)
+        {}
+
+        const T &key;
+        typename KeyTraits<T>::Prefix prefix;
     };
 
-    Leaf *root;
+    // three-way comparison of the probe with the key of p
+    static int compare(const Probe &probe, const Leaf *p)
+    {
+        int c = probe.prefix.compare(p->prefix);
+        return c != 0 ? c : KeyTraits<T>::compare(probe.key, p->data);
+    }
+
+    // whether the key of p orders before the probe, and the probe before the key of p;
+    // arithmetic keys compare directly, so that the searches stay free of branches
+    static bool below(const Leaf *p, const Probe &probe)
+    {
+        if constexpr(std::is_arithmetic<T>::value)
+            return p->data < probe.key;
+        else
+            return compare(probe, p) > 0;
+    }
+
+    static bool above(const Probe &probe, const Leaf *p)
+    {
+        if constexpr(std::is_arithmetic<T>::value)
+            return probe.key < p->data;
+        else
+            return compare(probe, p) < 0;
+    }
+
+    Leaf *new_leaf(const T &data, int data_index);
+    void delete_leaf(Leaf *p);
+    void release_leaves();
+
+    // the queries above in the subtree of p
+    static const Leaf *find_from(const Leaf *p, const T &key);
+    static const Leaf *lower_bound_from(const Leaf *p, const T &key);
+    static const Leaf *upper_bound_from(const Leaf *p, const T &key);
+    static int count_range_from(const Leaf *p, const T &lo, const T &hi);
+    static int rank_from(const Leaf *p, const T &key);
+    static const Leaf *select_from(const Leaf *p, int k);
+    static Statistics statistics_from(const Leaf *p);
+    template<class Visitor>
+    static void traverse_from(const Leaf *p, Visitor visit);
+
+#if SUBTREE_SIZES == 1
+    static int size_of(const Leaf *p)
+    {
+        return p != nullptr ? p->size : 0;
+    }
+#endif
+
+    // Every change of the links keeps the subtree sizes: the leaves that get other children
+    // recount themselves bottom-up, those that only gain or lose a descendant are adjusted.
+    static void update_size(Leaf *p)
+    {
+#if SUBTREE_SIZES == 1
+        p->size = size_of(p->left) + size_of(p->right) + 1;
+#else
+        (void) p;
+#endif
+    }
+
+    // adds delta to the size of every leaf on the search path of key above stop
+    void resize_path(const Probe &key, const Leaf *stop, int delta);
+    // sizes of a subtree whose links were set without them
+    static void count_sizes(Leaf *p);
+
+    // perfectly balanced subtree over the sorted range A[L..R] with valid AVL balance factors,
+    // leaves are indexed in preorder starting at index
+    Leaf *build_balanced(int L, int R, const std::vector<T> &A);
+    // height of a perfectly balanced tree with n leaves
+    static int balanced_height(int n);
 
-    int tree_size(Leaf *p) const;
-    int get_tree_height(Leaf *p) const;
-    int get_average_height(Leaf *p, int level) const;
-    int get_control_sum(Leaf *p) const;
     void draw_graph(Leaf *p);
     void print_leftToRight(Leaf *p, int indent) const;
     ogdf::node fill_graph(Leaf *p);
+    static std::string node_label(const Leaf *leaf);
+
+    // Drawing of the tree that drawGraph writes without building an OGDF Graph. Every drawn
+    // node has a slot in flat arrays, NULL nodes get slots of their own when NULL_RENDER is set.
+    // A fresh layout numbers the slots in preorder. A kept drawing (see incremental_drawing())
+    // reuses its slots and remembers the threads set by every node, so that a node can be laid
+    // out again while the subtrees below it that did not change keep their layout.
+    struct Drawing
+    {
+        enum State : char
+        {
+            Clean,
+            Changed, // children of the leaf changed since the last layout
+            Dirty,   // to be laid out again
+            Retired  // freed after the next layout
+        };
+
+        // threads set by the apportion of a node, with the modifier added to their holders
+        struct Threads
+        {
+            int slot[2] = {-1, -1};
+            double modifier[2] = {0, 0};
+        };
+
+        std::vector<Leaf *> leaf;     // nullptr for NULL nodes
+        std::vector<int> left, right; // child slots, -1 if there is none
+        std::vector<int> thread;      // next node on the contour of a slot without children
+        std::vector<double> prelim, modifier;
+        int root = -1;
+
+        bool kept = false;
+        std::vector<Threads> threads;
+        std::vector<char> state;
+        std::vector<int> changed, retired, free_slots;
+
+        // filled by place(): the slots in preorder, the child slots in the order their edges
+        // are written and the parent, depth and x-coordinate of every slot
+        std::vector<int> preorder, edges;
+        std::vector<int> parent, depth;
+        std::vector<double> x;
+
+        // filled by layout_view(): leaves and height of the subtree a glyph slot stands for,
+        // -1 for heights left out; glyph slots have no leaf, drawings of the whole tree no glyphs
+        std::vector<int> glyph_size, glyph_height;
+
+        // spacing of a default ogdf::TreeLayout
+        static constexpr double node_height = 25, level_distance = 50;
+        static constexpr double sibling_distance = 20, subtree_distance = 20;
+
+        int new_slot(Leaf *p);
+        void retire(int v);
+
+        int first_child(int v) const
+        {
+            return left[v] != -1 ? left[v] : right[v];
+        }
+
+        int last_child(int v) const
+        {
+            return right[v] != -1 ? right[v] : left[v];
+        }
+
+        double width(int v) const
+        {
+            return leaf[v] == nullptr ? 35.0 : 25.0;
+        }
+
+        bool is_glyph(int v) const
+        {
+            return !glyph_size.empty() && glyph_size[v] > 0;
+        }
+
+        double y(int v) const
+        {
+            return depth[v] * (node_height + level_distance);
+        }
+    };
+
+    // Walker/Buchheim layout of the subtree of root with the spacing of ogdf::TreeLayout,
+    // so the coordinates are the same as those of the OGDF path
+    static void layout_drawing(Drawing &d, Leaf *root);
+    // same for the part of the subtree of root the view takes in, its slots are numbered
+    // level by level and the heights of glyphs come from height(leaf)
+    template<class Height>
+    static void layout_view(Drawing &d, const Leaf *root, const View &view, Height height);
+    // first walk over slots numbered with every child after its parent
+    static void first_walk(Drawing &d);
+    // lays out again only the changed leaves of a kept drawing and their ancestors
+    void relayout_drawing(Drawing &d);
+    static int sync_slot(Drawing &d, Leaf *p, int v);
+    static void place_children(Drawing &d, int v);
+    static void apportion(Drawing &d, int v, int l, int r);
+    static double midpoint(const Drawing &d, int v);
+    // second walk, from the root down
+    static void place(Drawing &d);
+    // A placed drawing as SvgPrinter takes it, nodes numbered in preorder. Leaves are yellow
+    // ellipses, NULL nodes red ones and glyphs grey rounded rectangles, like drawGraph
+    // and drawView color them on the OGDF path.
+    class SvgDrawing : public SvgPrinter::StraightLineDrawing
+    {
+    public:
+        explicit SvgDrawing(const Drawing &d) : d(d), index(d.leaf.size(), -1)
+        {
+            for (size_t i = 0; i < d.preorder.size(); i++)
+                index[d.preorder[i]] = static_cast<int>(i);
+        }
 
-    Leaf *searchElementByIndex(Leaf *p, const int &index);
+        int numberOfNodes() const override { return static_cast<int>(d.preorder.size()); }
+        int numberOfEdges() const override { return static_cast<int>(d.edges.size()); }
+        double x(int v) const override { return d.x[d.preorder[v]]; }
+        double y(int v) const override { return d.y(d.preorder[v]); }
+        double width(int v) const override { return d.width(d.preorder[v]); }
+        double height(int) const override { return Drawing::node_height; }
+
+        Shape shape(int v) const override
+        {
+            return d.is_glyph(d.preorder[v]) ? Shape::RoundedRect : Shape::Ellipse;
+        }
+
+        Color fillColor(int v) const override
+        {
+            int slot = d.preorder[v];
+            if (d.is_glyph(slot))
+                return Color("#C0C0C0");
+            return Color(d.leaf[slot] == nullptr ? "#FF0000" : "#FFFF00");
+        }
+
+        std::string label(int v) const override
+        {
+            int slot = d.preorder[v];
+            return d.is_glyph(slot) ? glyph_label(d, slot) : node_label(d.leaf[slot]);
+        }
+
+        int source(int e) const override { return index[d.parent[d.edges[e]]]; }
+        int target(int e) const override { return index[d.edges[e]]; }
+        Color edgeStrokeColor(int) const override { return Color("#0000FF"); }
+
+    private:
+        const Drawing &d;
+        std::vector<int> index; // position of every slot in preorder
+    };
+
+    // writes d through SvgPrinter, in the same markup as the OGDF path
+    void write_svg(const Drawing &d, std::ostream &os) const;
+    // lays out the subtree of p afresh and writes it to filename, touches nothing of the tree
+    void write_drawing(Leaf *p, const std::string &filename) const;
+    template<class Height>
+    void draw_view(const View &view, Height height) const;
+    static std::string glyph_label(const Drawing &d, int v);
+
+    // copy takes over the slot of old in the kept drawing
+    void replaced(Leaf *old, Leaf *copy)
+    {
+        if (drawing != nullptr && old->slot != -1) {
+            copy->slot = old->slot;
+            drawing->leaf[copy->slot] = copy;
+            old->slot = -1;
+        }
+    }
+
+    // records that the children of p have changed, for the kept drawing and the statistics
+    void changed(Leaf *p)
+    {
+        // the joins of insert_batch and the set operations get here from several threads
+        stats_dirty.store(true, std::memory_order_relaxed);
+        if (drawing != nullptr && p != nullptr) {
+            if (p->slot == -1)
+                drawing->new_slot(p);
+            if (drawing->state[p->slot] == Drawing::Clean) {
+                drawing->state[p->slot] = Drawing::Changed;
+                drawing->changed.push_back(p->slot);
+            }
+        }
+    }
+
+    bool keep_drawing = false;
+    std::unique_ptr<Drawing> drawing; // kept between drawGraph calls once laid out
+
+    // result of the last statistics walk, stale once a leaf is made, freed or relinked; the
+    // mutex guards stats, the flag is set without it
+    mutable Statistics stats;
+    mutable std::atomic<bool> stats_dirty{true};
+    mutable std::mutex stats_mutex;
 
     int index = 0;
     Graph G;
+    NodeArray<Leaf *> graph_leaf{G, nullptr}; // leaf drawn by each node of G, nullptr for NULL nodes
+
+    template<class, bool> friend class CompactTree;
 
     std::vector<ogdf::node> NullNodes;
     std::string output_filename;
 
 private:
-    bool elem_found = false;
-    Leaf *search_result;
+#if LEAF_SLAB_SIZE > 0
+    static void fill_balanced(Leaf *p, int L, int R, const std::vector<T> &A, int first_index, int forks);
 
+    NodeArena<Leaf> arena;
+#endif
 };
 
 //-----TYPENAME ALIAS DEFINED
@@ -93,67 +745,415 @@ using Leaf = typename BinTree<T>::Leaf;
 //----------------------------
 
 template<typename T>
-void BinTree<T>::print()
+typename BinTree<T>::Leaf *BinTree<T>::new_leaf(const T &data, int data_index)
 {
-    print_leftToRight(this->root, 10);
+    stats_dirty = true;
+#if LEAF_SLAB_SIZE > 0
+    return arena.create(data, data_index);
+#else
+    return new Leaf(data, data_index);
+#endif
 }
 
 template<typename T>
-void BinTree<T>::print_leftToRight(Leaf *p, int indent) const
+void BinTree<T>::delete_leaf(Leaf *p)
 {
-    if (p != nullptr) {
-        this->print_leftToRight(p->right, indent + 10);
-
-        if (indent)
-            std::cout << std::setw(indent);
-        std::cout << p->data << std::endl;
+    stats_dirty = true;
+    if (drawing != nullptr && p->slot != -1)
+        drawing->retire(p->slot);
+
+#if LEAF_SLAB_SIZE > 0
+    arena.destroy(p);
+#else
+    delete p;
+#endif
+}
 
-        this->print_leftToRight(p->left, indent + 10);
+template<typename T>
+void BinTree<T>::release_leaves()
+{
+#if LEAF_SLAB_SIZE > 0
+    arena.release();
+#else
+    // pool leaves go back one by one, the stack keeps degenerate trees off the call stack
+    std::vector<Leaf *> stack;
+    if (this->root != nullptr)
+        stack.push_back(this->root);
+    while (!stack.empty()) {
+        Leaf *p = stack.back();
+        stack.pop_back();
+        if (p->left != nullptr)
+            stack.push_back(p->left);
+        if (p->right != nullptr)
+            stack.push_back(p->right);
+        delete p;
     }
+#endif
+    this->root = nullptr;
 }
 
 template<typename T>
-int BinTree<T>::tree_size(Leaf *p) const
+size_t BinTree<T>::memory_usage() const
 {
-    if (p == nullptr) return 0;
-    else {
-        return 1 + tree_size(p->left) + tree_size(p->right);
-    }
+#if LEAF_SLAB_SIZE > 0
+    return arena.bytes();
+#else
+    return size() * sizeof(Leaf);
+#endif
+}
+
+template<typename T>
+typename BinTree<T>::Leaf *BinTree<T>::build_balanced(int L, int R, const std::vector<T> &A)
+{
+    if (L > R)
+        return nullptr;
+
+    stats_dirty = true;
+#if LEAF_SLAB_SIZE > 0
+    // The leaves are laid out in preorder in one block, so the slot and the index of
+    // every leaf follow from its range alone and subranges can be filled by any thread
+    // in any order with the same result as the serial build.
+    int n = R - L + 1;
+    int forks = 0;
+    for (unsigned threads = std::thread::hardware_concurrency(); threads > 1; threads >>= 1)
+        forks++;
+
+    Leaf *block = arena.allocate_block(n);
+    fill_balanced(block, L, R, A, this->index, forks + 1);
+    this->index += n;
+    return block;
+#else
+    int m = (L + R) / 2;
+    Leaf *p = new_leaf(A[m], this->index++);
+    p->Bal = balanced_height(R - m) - balanced_height(m - L);
+#if SUBTREE_SIZES == 1
+    p->size = R - L + 1;
+#endif
+    p->left = build_balanced(L, m - 1, A);
+    p->right = build_balanced(m + 1, R, A);
+    return p;
+#endif
 }
 
+#if LEAF_SLAB_SIZE > 0
 template<typename T>
-int BinTree<T>::get_tree_height(Leaf *p) const
+void BinTree<T>::fill_balanced(Leaf *p, int L, int R, const std::vector<T> &A, int first_index, int forks)
 {
-    if (p == nullptr) return 0;
+    int m = (L + R) / 2;
+    new(p) Leaf(A[m], first_index);
+    p->Bal = balanced_height(R - m) - balanced_height(m - L);
+#if SUBTREE_SIZES == 1
+    p->size = R - L + 1;
+#endif
+
+    // the left subtree directly follows its parent, the right one follows the left
+    Leaf *left = m > L ? p + 1 : nullptr;
+    Leaf *right = m < R ? p + 1 + (m - L) : nullptr;
+    p->left = left;
+    p->right = right;
+
+    if (forks > 0 && R - L + 1 >= PARALLEL_CUTOFF) {
+        std::thread worker(fill_balanced, left, L, m - 1, std::cref(A), first_index + 1, forks - 1);
+        fill_balanced(right, m + 1, R, A, first_index + 1 + (m - L), forks - 1);
+        worker.join();
+    }
     else {
-        return 1 + std::max(get_tree_height(p->left), get_tree_height(p->right));
+        if (left != nullptr)
+            fill_balanced(left, L, m - 1, A, first_index + 1, 0);
+        if (right != nullptr)
+            fill_balanced(right, m + 1, R, A, first_index + 1 + (m - L), 0);
     }
 }
+#endif
 
 template<typename T>
-int BinTree<T>::get_average_height(Leaf *p, int level) const
+int BinTree<T>::balanced_height(int n)
 {
-    int size = 0;
-    if (p == nullptr) return 0;
-    else
-        return level + get_average_height(p->left, level + 1) + get_average_height(p->right, level + 1);
+    int h = 0;
+    for (; n > 0; n >>= 1)
+        h++;
+    return h;
 }
 
 template<typename T>
-int BinTree<T>::get_control_sum(Leaf *p) const
+void BinTree<T>::print()
 {
-    int size = 0;
-    if constexpr(std::is_same<T, std::string>::value)
-        return 0;
-    if (p == nullptr ) return 0;
-    else
-        return p->data + get_control_sum(p->left) + get_control_sum(p->right);
+    print_leftToRight(this->root, 10);
 }
 
 template<typename T>
-void BinTree<T>::draw_graph(Leaf *p)
+void BinTree<T>::print_leftToRight(Leaf *p, int indent) const
 {
-    fill_graph(this->root);
+    // right subtree, leaf, left subtree, each level indented 10 more
+    std::vector<std::pair<Leaf *, int>> stack;
+
+    while (p != nullptr || !stack.empty()) {
+        while (p != nullptr) {
+            stack.emplace_back(p, indent);
+            p = p->right;
+            indent += 10;
+        }
+
+        p = stack.back().first;
+        indent = stack.back().second;
+        stack.pop_back();
+
+        if (indent)
+            std::cout << std::setw(indent);
+        std::cout << p->data << std::endl;
+
+        p = p->left;
+        indent += 10;
+    }
+}
+
+template<typename T>
+template<class Visitor>
+void BinTree<T>::traverse_from(const Leaf *p, Visitor visit)
+{
+    std::vector<std::pair<const Leaf *, int>> stack;
+    if (p != nullptr)
+        stack.emplace_back(p, 1);
+
+    while (!stack.empty()) {
+        p = stack.back().first;
+        int level = stack.back().second;
+        stack.pop_back();
+
+        visit(*p, level);
+
+        if (p->right != nullptr)
+            stack.emplace_back(p->right, level + 1);
+        if (p->left != nullptr)
+            stack.emplace_back(p->left, level + 1);
+    }
+}
+
+// Searches descend without an equality test on the way. For arithmetic keys the step is
+// a compare and two selects, which compile to conditional moves, so the loop does not
+// stall on mispredicted branches over random probes. Other keys keep the early exit of
+// the classic three-way search because their comparisons are too costly to repeat.
+template<typename T>
+const typename BinTree<T>::Leaf *BinTree<T>::find_from(const Leaf *p, const T &key)
+{
+    if constexpr(std::is_arithmetic<T>::value) {
+        p = lower_bound_from(p, key);
+        return p != nullptr && !(key < p->data) ? p : nullptr;
+    }
+    else {
+        Probe probe(key);
+        while (p != nullptr) {
+            int c = compare(probe, p);
+            if (c < 0)
+                p = p->left;
+            else if (c > 0)
+                p = p->right;
+            else
+                return p;
+        }
+        return nullptr;
+    }
+}
+
+template<typename T>
+const typename BinTree<T>::Leaf *BinTree<T>::lower_bound_from(const Leaf *p, const T &key)
+{
+    Probe probe(key);
+    const Leaf *bound = nullptr;
+    while (p != nullptr) {
+        bool right = below(p, probe);
+        bound = right ? bound : p;
+        p = right ? p->right : p->left;
+    }
+    return bound;
+}
+
+template<typename T>
+const typename BinTree<T>::Leaf *BinTree<T>::upper_bound_from(const Leaf *p, const T &key)
+{
+    Probe probe(key);
+    const Leaf *bound = nullptr;
+    while (p != nullptr) {
+        bool right = !above(probe, p);
+        bound = right ? bound : p;
+        p = right ? p->right : p->left;
+    }
+    return bound;
+}
+
+template<typename T>
+int BinTree<T>::count_range_from(const Leaf *p, const T &lo, const T &hi)
+{
+#if SUBTREE_SIZES == 1
+    return KeyTraits<T>::compare(lo, hi) < 0 ? rank_from(p, hi) - rank_from(p, lo) : 0;
+#else
+    // in-order walk from lower_bound(lo), the stack holds the pending ancestors
+    Probe low(lo), high(hi);
+    std::vector<const Leaf *> stack;
+    while (p != nullptr) {
+        if (below(p, low)) {
+            p = p->right;
+        }
+        else {
+            stack.push_back(p);
+            p = p->left;
+        }
+    }
+
+    int count = 0;
+    while (!stack.empty()) {
+        p = stack.back();
+        stack.pop_back();
+        if (!below(p, high))
+            break;
+        count++;
+        for (p = p->right; p != nullptr; p = p->left)
+            stack.push_back(p);
+    }
+    return count;
+#endif
+}
+
+template<typename T>
+int BinTree<T>::rank_from(const Leaf *p, const T &key)
+{
+    Probe probe(key);
+    int rank = 0;
+#if SUBTREE_SIZES == 1
+    while (p != nullptr) {
+        if (below(p, probe)) {
+            rank += size_of(p->left) + 1;
+            p = p->right;
+        }
+        else {
+            p = p->left;
+        }
+    }
+#else
+    traverse_from(p, [&rank, &probe](const Leaf &leaf, int) {
+        if (below(&leaf, probe))
+            rank++;
+    });
+#endif
+    return rank;
+}
+
+template<typename T>
+const typename BinTree<T>::Leaf *BinTree<T>::select_from(const Leaf *p, int k)
+{
+    if (k < 0)
+        return nullptr;
+
+#if SUBTREE_SIZES == 1
+    while (p != nullptr) {
+        int left = size_of(p->left);
+        if (k < left) {
+            p = p->left;
+        }
+        else if (k > left) {
+            k -= left + 1;
+            p = p->right;
+        }
+        else {
+            return p;
+        }
+    }
+    return nullptr;
+#else
+    // in-order walk up to the k-th leaf
+    std::vector<const Leaf *> stack;
+    while (p != nullptr || !stack.empty()) {
+        for (; p != nullptr; p = p->left)
+            stack.push_back(p);
+        p = stack.back();
+        stack.pop_back();
+        if (k-- == 0)
+            return p;
+        p = p->right;
+    }
+    return nullptr;
+#endif
+}
+
+template<typename T>
+void BinTree<T>::resize_path(const Probe &key, const Leaf *stop, int delta)
+{
+#if SUBTREE_SIZES == 1
+    for (Leaf *p = this->root; p != stop; p = compare(key, p) < 0 ? p->left : p->right)
+        p->size += delta;
+#else
+    (void) key;
+    (void) stop;
+    (void) delta;
+#endif
+}
+
+template<typename T>
+void BinTree<T>::count_sizes(Leaf *p)
+{
+#if SUBTREE_SIZES == 1
+    // postorder, a leaf is counted once both of its subtrees are
+    std::vector<std::pair<Leaf *, bool>> stack;
+    if (p != nullptr)
+        stack.emplace_back(p, false);
+    while (!stack.empty()) {
+        auto &top = stack.back();
+        if (top.second) {
+            update_size(top.first);
+            stack.pop_back();
+            continue;
+        }
+        top.second = true;
+        Leaf *q = top.first;
+        if (q->right != nullptr)
+            stack.emplace_back(q->right, false);
+        if (q->left != nullptr)
+            stack.emplace_back(q->left, false);
+    }
+#else
+    (void) p;
+#endif
+}
+
+template<typename T>
+typename BinTree<T>::Statistics BinTree<T>::statistics_from(const Leaf *p)
+{
+    Statistics st;
+    traverse_from(p, [&st](const Leaf &leaf, int level) {
+        st.size++;
+        st.height = std::max(st.height, level);
+        st.path_length += level;
+        st.control_sum += KeyTraits<T>::sum(leaf.data);
+    });
+    return st;
+}
+
+template<typename T>
+void BinTree<T>::draw_graph(Leaf *p)
+{
+#if DIRECT_LAYOUT == 1
+    // only the whole tree keeps its drawing
+    if (!keep_drawing || p != this->root) {
+        write_drawing(p, output_filename);
+        return;
+    }
+
+    if (drawing == nullptr) {
+        drawing.reset(new Drawing);
+        drawing->kept = true;
+        layout_drawing(*drawing, p);
+    }
+    else {
+        relayout_drawing(*drawing);
+    }
+    place(*drawing);
+
+    std::fstream fs(output_filename, std::ios::out);
+    write_svg(*drawing, fs);
+#else
+    G.clear();
+    NullNodes.clear();
+    fill_graph(p);
 
 #if NULL_RENDER == 0
     for (auto i : NullNodes) {
@@ -176,282 +1176,1754 @@ void BinTree<T>::draw_graph(Leaf *p)
         GA.width(v) = 25.0; // set the width to 40.0
         GA.shape(v) = ogdf::Shape::Ellipse;
 
-        const char *pchar;
+        Leaf *leaf = graph_leaf[v];
 
-        if (std::find(NullNodes.begin(), NullNodes.end(), v) != NullNodes.end()) {
+        if (leaf == nullptr) {
             GA.fillColor(v) = Color("#FF0000");
             GA.width(v) = 35.0;
-            pchar = "NULL";
-            GA.label(v) = pchar;
+        }
+        GA.label(v) = node_label(leaf);
+    }
+
+    for (edge e = G.firstEdge(); e; e = e->succ())// set default edge color and type
+    {
+        GA.bends(e);
+        GA.arrowType(e) = ogdf::EdgeArrow::Last;
+        GA.strokeColor(e) = Color("#0000FF");
+    }
+
+    TreeLayout SL; //Compute a hierarchical drawing of G (using SugiyamaLayout)
+
+    SL.call(GA);
+
+    // the document is written while it is generated instead of being built in memory first
+    GraphIO::SVGSettings settings = GraphIO::svgSettings;
+    settings.streaming(true);
+
+    std::fstream fs(output_filename, std::ios::out);
+    GraphIO::drawSVG(GA, fs, settings);
+#endif
+}
+
+template<typename T>
+std::string BinTree<T>::node_label(const Leaf *leaf)
+{
+    if (leaf == nullptr)
+        return "NULL";
+
+    return KeyTraits<T>::format(leaf->data);
+}
+
+template<typename T>
+void BinTree<T>::write_drawing(Leaf *p, const std::string &filename) const
+{
+    Drawing d;
+    layout_drawing(d, p);
+    place(d);
+
+    std::fstream fs(filename, std::ios::out);
+    write_svg(d, fs);
+}
+
+template<typename T>
+std::string BinTree<T>::glyph_label(const Drawing &d, int v)
+{
+    std::string label = std::to_string(d.glyph_size[v]);
+    if (d.glyph_height[v] >= 0)
+        label += " h" + std::to_string(d.glyph_height[v]);
+    return label;
+}
+
+template<typename T>
+template<class Height>
+void BinTree<T>::draw_view(const View &view, Height height) const
+{
+    Drawing d;
+    layout_view(d, view.root != nullptr ? view.root : this->root, view, height);
+    place(d);
+
+#if DIRECT_LAYOUT == 1
+    std::fstream fs(output_filename, std::ios::out);
+    write_svg(d, fs);
+#else
+    // the nodes and edges of the view in the order drawGraph creates them
+    Graph G;
+    GraphAttributes GA(G, GraphAttributes::nodeGraphics |
+        GraphAttributes::edgeGraphics |
+        GraphAttributes::nodeLabel |
+        GraphAttributes::nodeStyle |
+        GraphAttributes::edgeType |
+        GraphAttributes::edgeArrow |
+        GraphAttributes::edgeStyle);
+
+    std::vector<node> nodes(d.leaf.size());
+    for (int v : d.preorder) {
+        node u = nodes[v] = G.newNode();
+        GA.height(u) = Drawing::node_height;
+        GA.width(u) = d.width(v);
+        if (d.is_glyph(v)) {
+            GA.fillColor(u) = Color("#C0C0C0");
+            GA.shape(u) = ogdf::Shape::RoundedRect;
+            GA.label(u) = glyph_label(d, v);
+        }
+        else {
+            GA.fillColor(u) = Color("#FFFF00");
+            GA.shape(u) = ogdf::Shape::Ellipse;
+            GA.label(u) = node_label(d.leaf[v]);
+        }
+    }
+    for (int t : d.edges) {
+        edge e = G.newEdge(nodes[d.parent[t]], nodes[t]);
+        GA.arrowType(e) = ogdf::EdgeArrow::Last;
+        GA.strokeColor(e) = Color("#0000FF");
+    }
+
+    TreeLayout layout;
+    layout.call(GA);
+
+    GraphIO::SVGSettings settings = GraphIO::svgSettings;
+    settings.streaming(true);
+
+    std::fstream fs(output_filename, std::ios::out);
+    GraphIO::drawSVG(GA, fs, settings);
+#endif
+}
+
+template<typename T>
+ogdf::node BinTree<T>::fill_graph(Leaf *p)
+{
+    // для NULL-указателя создаем узел без привязки к дереву, graph_leaf остается nullptr
+    auto new_node = [this](Leaf *leaf) {
+        node v = G.newNode();
+        graph_leaf[v] = leaf;
+        if (leaf == nullptr)
+            this->NullNodes.push_back(v);
+        return v;
+    };
+
+    // Iterative version of the recursive walk: nodes are created in preorder and the
+    // edge to a child only once its subtree is complete, so G comes out in the same order.
+    struct Frame
+    {
+        Leaf *p;
+        node v;
+        int next_child; // 0 - left, 1 - right, 2 - done
+    };
+
+    node rooted = new_node(p);
+    std::vector<Frame> stack;
+    if (p != nullptr)
+        stack.push_back({p, rooted, 0});
+
+    while (!stack.empty()) {
+        Frame &top = stack.back();
+        if (top.next_child == 2) {
+            node done = top.v;
+            stack.pop_back();
+            if (!stack.empty())
+                G.newEdge(stack.back().v, done);
+            continue;
+        }
+
+        Leaf *child = top.next_child == 0 ? top.p->left : top.p->right;
+        top.next_child++;
+
+        node v = new_node(child);
+        if (child != nullptr)
+            stack.push_back({child, v, 0});
+        else
+            G.newEdge(top.v, v);
+    }
+    return rooted;
+}
+
+template<typename T>
+void BinTree<T>::incremental_drawing(bool enable)
+{
+    keep_drawing = enable;
+    if (!enable)
+        drawing.reset();
+}
+
+template<typename T>
+int BinTree<T>::Drawing::new_slot(Leaf *p)
+{
+    int v;
+    if (!free_slots.empty()) {
+        v = free_slots.back();
+        free_slots.pop_back();
+        leaf[v] = p;
+        left[v] = right[v] = thread[v] = -1;
+        prelim[v] = modifier[v] = 0;
+    }
+    else {
+        v = static_cast<int>(leaf.size());
+        leaf.push_back(p);
+        left.push_back(-1);
+        right.push_back(-1);
+        thread.push_back(-1);
+        prelim.push_back(0);
+        modifier.push_back(0);
+    }
+
+    if (kept) {
+        if (v == static_cast<int>(state.size())) {
+            state.push_back(Clean);
+            threads.emplace_back();
         }
         else {
-            std::string s;
+            state[v] = Clean;
+            threads[v] = Threads();
+        }
+        if (p != nullptr)
+            p->slot = v;
+    }
+    return v;
+}
+
+template<typename T>
+void BinTree<T>::Drawing::retire(int v)
+{
+    state[v] = Retired;
+    retired.push_back(v);
+    // the NULL nodes below v go with it
+    for (int c : {left[v], right[v]}) {
+        if (c != -1 && leaf[c] == nullptr && state[c] != Retired) {
+            state[c] = Retired;
+            retired.push_back(c);
+        }
+    }
+}
+
+template<typename T>
+void BinTree<T>::layout_drawing(Drawing &d, Leaf *root)
+{
+    bool kept = d.kept;
+    d = Drawing();
+    d.kept = kept;
+
+    // slots in preorder
+    struct Frame
+    {
+        Leaf *p;
+        int v;
+        int next_child; // 0 - left, 1 - right, 2 - done
+    };
+
+    std::vector<Frame> stack;
+    if (root != nullptr)
+        stack.push_back({root, d.new_slot(root), 0});
+#if NULL_RENDER == 1
+    else
+        d.new_slot(nullptr);
+#endif
+    d.root = d.leaf.empty() ? -1 : 0;
+
+    while (!stack.empty()) {
+        Frame &top = stack.back();
+        if (top.next_child == 2) {
+            stack.pop_back();
+            continue;
+        }
+
+        Leaf *child = top.next_child == 0 ? top.p->left : top.p->right;
+        int parent = top.v;
+        bool is_left = top.next_child++ == 0;
+#if NULL_RENDER == 0
+        if (child == nullptr)
+            continue;
+#endif
+
+        int v = d.new_slot(child);
+        (is_left ? d.left : d.right)[parent] = v;
+        if (child != nullptr)
+            stack.push_back({child, v, 0});
+    }
+
+    first_walk(d);
+}
+
+template<typename T>
+template<class Height>
+void BinTree<T>::layout_view(Drawing &d, const Leaf *root, const View &view, Height height)
+{
+    d = Drawing();
+    if (root == nullptr)
+        return;
+
+    auto size = [](const Leaf *p) {
+#if SUBTREE_SIZES == 1
+        return size_of(p);
+#else
+        return statistics_from(p).size;
+#endif
+    };
+    // A subtree of n leaves laid out in full is at least as wide as its lowest level,
+    // which holds about half of them in a balanced tree.
+    auto too_narrow = [&view](const Leaf *p) {
+#if SUBTREE_SIZES == 1
+        double leaves = (size_of(p) + 1) / 2.0;
+        return leaves * (25.0 + Drawing::sibling_distance) * view.scale < view.min_pixels;
+#else
+        (void) p;
+        return false;
+#endif
+    };
+
+    // the drawing only reads the leaves, glyph slots get none; a leaf without children
+    // is drawn as itself, a glyph would not take less room
+    std::vector<int> level;
+    int drawn = 0;
+    auto add = [&](const Leaf *p, int l) {
+        bool collapse = (p->left != nullptr || p->right != nullptr)
+            && ((view.depth > 0 && l > view.depth) || (view.nodes > 0 && drawn >= view.nodes) || too_narrow(p));
+        int v = d.new_slot(collapse ? nullptr : const_cast<Leaf *>(p));
+        d.glyph_size.push_back(collapse ? size(p) : 0);
+        d.glyph_height.push_back(collapse && view.heights ? height(p) : -1);
+        level.push_back(l);
+        if (!collapse)
+            drawn++;
+        return v;
+    };
+
+    // slots level by level, so the budget goes to the levels nearest to the root
+    d.root = add(root, 1);
+    for (int v = 0; v < static_cast<int>(d.leaf.size()); v++) {
+        const Leaf *p = d.leaf[v];
+        if (p == nullptr)
+            continue;
+        if (p->left != nullptr) {
+            int c = add(p->left, level[v] + 1);
+            d.left[v] = c;
+        }
+        if (p->right != nullptr) {
+            int c = add(p->right, level[v] + 1);
+            d.right[v] = c;
+        }
+    }
+
+    first_walk(d);
+}
+
+// Children come after their parent, so walking the slots backwards finishes
+// both subtrees of a node before the node itself.
+template<typename T>
+void BinTree<T>::first_walk(Drawing &d)
+{
+    for (int v = static_cast<int>(d.leaf.size()) - 1; v >= 0; v--)
+        place_children(d, v);
+    if (d.root != -1)
+        d.prelim[d.root] = midpoint(d, d.root);
+}
 
-            if constexpr(std::is_same<T, std::string>::value) {
-                s = searchElementByIndex(this->root, v->index())->data;
+template<typename T>
+void BinTree<T>::relayout_drawing(Drawing &d)
+{
+    // A leaf has to be laid out again if its children changed or if it is an ancestor of
+    // one that did. The ancestors are found by searching for the key of every changed leaf;
+    // deeper leaves tend to be recorded later, so going backwards finds most of them marked.
+    std::vector<std::pair<int, int>> dirty; // depth and slot
+    for (auto it = d.changed.rbegin(); it != d.changed.rend(); ++it) {
+        if (d.state[*it] != Drawing::Changed)
+            continue;
+
+        const Leaf *target = d.leaf[*it];
+        Leaf *p = this->root;
+        for (int level = 0; p != nullptr; level++) {
+            if (d.state[p->slot] != Drawing::Dirty) {
+                d.state[p->slot] = Drawing::Dirty;
+                dirty.emplace_back(level, p->slot);
             }
+            if (p == target)
+                break;
+            p = KeyTraits<T>::compare(target->data, p->data) < 0 ? p->left : p->right;
+        }
+    }
 
-            if constexpr(std::is_same<T, int>::value) {
-                s = to_string(searchElementByIndex(this->root, v->index())->data);
+    // take back the threads set by the leaves laid out again and by the removed ones,
+    // whatever was threaded to a dirty leaf is set up again from scratch
+    auto undo = [&d](int v) {
+        for (int k = 0; k < 2; k++) {
+            int t = d.threads[v].slot[k];
+            if (t != -1) {
+                d.thread[t] = -1;
+                d.modifier[t] -= d.threads[v].modifier[k];
             }
+        }
+        d.threads[v] = typename Drawing::Threads();
+    };
+    for (auto &v : dirty)
+        undo(v.second);
+    for (int v : d.retired)
+        undo(v);
+    for (auto &v : dirty) {
+        d.thread[v.second] = -1;
+        d.modifier[v.second] = 0;
+    }
+
+    std::sort(dirty.begin(), dirty.end(), std::greater<std::pair<int, int>>());
+    for (auto &v : dirty) {
+        int left = sync_slot(d, d.leaf[v.second]->left, d.left[v.second]);
+        d.left[v.second] = left;
+        int right = sync_slot(d, d.leaf[v.second]->right, d.right[v.second]);
+        d.right[v.second] = right;
+        place_children(d, v.second);
+    }
+
+    d.root = sync_slot(d, this->root, d.root);
+    if (d.root != -1) {
+        d.prelim[d.root] = midpoint(d, d.root);
+        d.modifier[d.root] = 0;
+    }
+
+    for (auto &v : dirty)
+        d.state[v.second] = Drawing::Clean;
+    for (int v : d.retired)
+        d.free_slots.push_back(v);
+    d.retired.clear();
+    d.changed.clear();
+}
+
+// Slot to draw p in where v was drawn before, NULL nodes keep their slot while they stay NULL.
+template<typename T>
+int BinTree<T>::sync_slot(Drawing &d, Leaf *p, int v)
+{
+    bool null_slot = v != -1 && d.leaf[v] == nullptr && d.state[v] != Drawing::Retired;
+    if (p != nullptr) {
+        if (null_slot) {
+            d.state[v] = Drawing::Retired;
+            d.retired.push_back(v);
+        }
+        return p->slot;
+    }
+#if NULL_RENDER == 1
+    return null_slot ? v : d.new_slot(nullptr);
+#else
+    return -1;
+#endif
+}
+
+// centre of the children of v, 0 for a slot without children
+template<typename T>
+double BinTree<T>::midpoint(const Drawing &d, int v)
+{
+    int l = d.first_child(v);
+    if (l == -1)
+        return 0;
+    return (d.prelim[l] + d.prelim[d.last_child(v)]) / 2;
+}
+
+// Places the children of v relative to each other once their own subtrees are laid out.
+// Both are centred over their children, the right one is then moved next to its sibling.
+template<typename T>
+void BinTree<T>::place_children(Drawing &d, int v)
+{
+    int l = d.first_child(v), r = d.last_child(v);
+    if (l == -1)
+        return;
+
+    d.prelim[l] = midpoint(d, l);
+    if (d.first_child(l) != -1)
+        d.modifier[l] = 0;
+
+    if (l != r) {
+        double centre = midpoint(d, r);
+        d.prelim[r] = d.prelim[l] + (d.width(r) + d.width(l)) / 2 + Drawing::sibling_distance;
+        if (d.first_child(r) != -1)
+            d.modifier[r] = d.prelim[r] - centre;
+        apportion(d, v, l, r);
+    }
+}
+
+// Moves the right subtree r of v away from its left sibling l until the contours keep
+// subtree_distance apart and threads the shorter contour onto the longer one.
+// With two children per node the shifts of subtrees in between are never needed.
+template<typename T>
+void BinTree<T>::apportion(Drawing &d, int v, int l, int r)
+{
+    auto next_on_left_contour = [&d](int u) {
+        return d.first_child(u) != -1 ? d.first_child(u) : d.thread[u];
+    };
+    auto next_on_right_contour = [&d](int u) {
+        return d.last_child(u) != -1 ? d.last_child(u) : d.thread[u];
+    };
+
+    double left_sum_out = 0, left_sum_in = 0, right_sum_in = 0, right_sum_out = 0;
+    int left_out = l, left_in = l, right_in = r, right_out = r;
+
+    for (;;) {
+        left_sum_out += d.modifier[left_out];
+        left_sum_in += d.modifier[left_in];
+        right_sum_in += d.modifier[right_in];
+        right_sum_out += d.modifier[right_out];
+
+        if (next_on_left_contour(left_out) == -1 || next_on_right_contour(right_out) == -1)
+            break;
+
+        left_out = next_on_left_contour(left_out);
+        left_in = next_on_right_contour(left_in);
+        right_in = next_on_left_contour(right_in);
+        right_out = next_on_right_contour(right_out);
+
+        double move = d.prelim[left_in] + left_sum_in
+            + (d.width(left_in) + d.width(right_in)) / 2
+            + Drawing::subtree_distance
+            - d.prelim[right_in] - right_sum_in;
+        if (move > 0) {
+            d.prelim[r] += move;
+            d.modifier[r] += move;
+            right_sum_in += move;
+            right_sum_out += move;
+        }
+    }
+
+    auto set_thread = [&d, v](int k, int holder, int next, double shift) {
+        d.thread[holder] = next;
+        d.modifier[holder] += shift;
+        if (d.kept) {
+            d.threads[v].slot[k] = holder;
+            d.threads[v].modifier[k] = shift;
+        }
+    };
+    if (next_on_right_contour(right_out) == -1 && next_on_right_contour(left_in) != -1)
+        set_thread(0, right_out, next_on_right_contour(left_in), left_sum_in - right_sum_out);
+    if (next_on_left_contour(left_out) == -1 && next_on_left_contour(right_in) != -1)
+        set_thread(1, left_out, next_on_left_contour(right_in), right_sum_in - left_sum_out);
+}
+
+template<typename T>
+void BinTree<T>::place(Drawing &d)
+{
+    int n = static_cast<int>(d.leaf.size());
+    d.preorder.clear();
+    d.edges.clear();
+    d.parent.assign(n, -1);
+    d.depth.assign(n, 0);
+    d.x.assign(n, 0);
+    if (d.root == -1)
+        return;
+
+    // the edge to a child is written once its subtree is complete, the order fill_graph creates them in
+    struct Frame
+    {
+        int v;
+        int next_child; // 0 - left, 1 - right, 2 - done
+        double modifier_sum; // passed on to the children
+    };
+
+    std::vector<Frame> stack;
+    d.preorder.push_back(d.root);
+    d.x[d.root] = 0;
+    stack.push_back({d.root, 0, d.modifier[d.root] - d.prelim[d.root]});
+
+    while (!stack.empty()) {
+        Frame &top = stack.back();
+        if (top.next_child == 2) {
+            int done = top.v;
+            stack.pop_back();
+            if (!stack.empty())
+                d.edges.push_back(done);
+            continue;
+        }
+
+        int v = top.next_child++ == 0 ? d.left[top.v] : d.right[top.v];
+        if (v == -1)
+            continue;
+
+        d.preorder.push_back(v);
+        d.parent[v] = top.v;
+        d.depth[v] = d.depth[top.v] + 1;
+        d.x[v] = d.prelim[v] + top.modifier_sum;
+        stack.push_back({v, 0, top.modifier_sum + d.modifier[v]});
+    }
+}
+
+template<typename T>
+void BinTree<T>::write_svg(const Drawing &d, std::ostream &os) const
+{
+    GraphIO::SVGSettings settings = GraphIO::svgSettings;
+    settings.streaming(true);
+
+    SvgPrinter::draw(os, SvgDrawing(d), settings);
+}
+
+// COMPACT TREE
+
+// Read-only snapshot of a BinTree for traversal-heavy work. The nodes live in one
+// vector in preorder with 32-bit child slots; with SplitKeys the keys are kept in
+// a separate array from the links (structure of arrays), otherwise next to them.
+// Any of the trees below can be built as usual and then frozen into this form.
+template<class T, bool SplitKeys = true>
+class CompactTree
+{
+public:
+    static constexpr uint32_t null_slot = UINT32_MAX;
+
+    explicit CompactTree(const BinTree<T> &tree);
+
+    int size() const
+    {
+        return static_cast<int>(links.size());
+    }
+
+    int tree_height() const;
+    int average_height() const;
+    int64_t control_sum() const;
+    bool contains(const T &data) const;
+
+    size_t memory_usage() const
+    {
+        return links.capacity() * sizeof(links[0]) + keys.capacity() * sizeof(T);
+    }
+
+private:
+    struct Links
+    {
+        uint32_t left;
+        uint32_t right;
+    };
+
+    struct LinkedKey
+    {
+        uint32_t left;
+        uint32_t right;
+        T data;
+    };
+
+    // with SplitKeys the links hold bare slots and the keys sit in their own array
+    std::vector<typename std::conditional<SplitKeys, Links, LinkedKey>::type> links;
+    std::vector<T> keys;
+
+    const T &key(uint32_t i) const
+    {
+        if constexpr(SplitKeys)
+            return keys[i];
+        else
+            return links[i].data;
+    }
+
+    void depths(std::vector<int> &depth) const;
+};
+
+template<typename T, bool SplitKeys>
+CompactTree<T, SplitKeys>::CompactTree(const BinTree<T> &tree)
+{
+    using Leaf = typename BinTree<T>::Leaf;
+
+    struct Pending
+    {
+        const Leaf *p;
+        uint32_t parent;
+        bool right;
+    };
+
+    // preorder walk, every pending entry knows which slot of its parent to patch
+    std::vector<Pending> stack;
+    if (tree.root != nullptr)
+        stack.push_back({tree.root, null_slot, false});
+
+    while (!stack.empty()) {
+        Pending top = stack.back();
+        stack.pop_back();
+
+        uint32_t i = static_cast<uint32_t>(links.size());
+        if (top.parent != null_slot) {
+            if (top.right)
+                links[top.parent].right = i;
+            else
+                links[top.parent].left = i;
+        }
+
+        if constexpr(SplitKeys) {
+            links.push_back({null_slot, null_slot});
+            keys.push_back(top.p->data);
+        }
+        else {
+            links.push_back({null_slot, null_slot, top.p->data});
+        }
+
+        if (top.p->right != nullptr)
+            stack.push_back({top.p->right, i, true});
+        if (top.p->left != nullptr)
+            stack.push_back({top.p->left, i, false});
+    }
+}
+
+// children always come after their parent, so one forward sweep yields all depths
+template<typename T, bool SplitKeys>
+void CompactTree<T, SplitKeys>::depths(std::vector<int> &depth) const
+{
+    depth.assign(links.size(), 1);
+    for (uint32_t i = 0; i < links.size(); i++) {
+        if (links[i].left != null_slot)
+            depth[links[i].left] = depth[i] + 1;
+        if (links[i].right != null_slot)
+            depth[links[i].right] = depth[i] + 1;
+    }
+}
+
+template<typename T, bool SplitKeys>
+int CompactTree<T, SplitKeys>::tree_height() const
+{
+    std::vector<int> depth;
+    depths(depth);
+    return depth.empty() ? 0 : *std::max_element(depth.begin(), depth.end());
+}
+
+template<typename T, bool SplitKeys>
+int CompactTree<T, SplitKeys>::average_height() const
+{
+    if (links.empty())
+        return 0;
+
+    std::vector<int> depth;
+    depths(depth);
+    int64_t total = 0;
+    for (int d : depth)
+        total += d;
+    return static_cast<int>(total / size());
+}
+
+template<typename T, bool SplitKeys>
+int64_t CompactTree<T, SplitKeys>::control_sum() const
+{
+    int64_t sum = 0;
+    for (uint32_t i = 0; i < links.size(); i++)
+        sum += KeyTraits<T>::sum(key(i));
+    return sum;
+}
+
+template<typename T, bool SplitKeys>
+bool CompactTree<T, SplitKeys>::contains(const T &data) const
+{
+    uint32_t i = links.empty() ? null_slot : 0;
+    while (i != null_slot) {
+        int c = KeyTraits<T>::compare(data, key(i));
+        if (c < 0)
+            i = links[i].left;
+        else if (c > 0)
+            i = links[i].right;
+        else
+            return true;
+    }
+    return false;
+}
+
+// COMPACT TREE END
+
+template<typename T>
+class IdealTree: public BinTree<T>
+{
+public:
+    IdealTree<T>(int L, int R, const std::vector<T> &A, const std::string &filename)
+    {
+        this->output_filename = filename;
+        this->index = 0;
+        BinTree<T>::root = IDSP(L, R, A);
+    }
+
+    IdealTree<T>(const std::vector<T> &A, const std::string &filename)
+    {
+        this->output_filename = filename;
+        this->index = 0;
+        BinTree<T>::root = IDSP(0, static_cast<int>(A.size() - 1), A);
+    }
+private:
+    Leaf<T> *IDSP(int L, int R, const std::vector<T> &A);
+};
+
+template<typename T>
+Leaf<T> *IdealTree<T>::IDSP(int L, int R, const std::vector<T> &A)
+{
+    return this->build_balanced(L, R, A);
+}
+
+//RANDOM TREE BEGIN
+
+template<typename T>
+class RandomTree: public BinTree<T>
+{
+public:
+    explicit RandomTree<T>(const std::vector<T> &a, const std::string &filename)
+    {
+        this->output_filename = filename;
+        bulk_load(a);
+    }
+    RandomTree<T>()
+    {};
+
+    void deleteElem(const T &data);
+
+    void addElem(const T &data)
+    {
+        RDP(data);
+    }
+protected:
+    using Probe = typename BinTree<T>::Probe;
+
+    void RDP(const T &data);
+
+private:
+    void bulk_load(const std::vector<T> &a);
+};
+
+// Builds the same tree as calling RDP for a[0], a[1], ... in turn, in O(n log n)
+// instead of O(n * height), which is quadratic for sorted input.
+// Inserting in order makes every key the ancestor of all keys between it and its
+// neighbours that arrive later, so the result is the Cartesian tree of the distinct
+// keys ordered by key and heap-ordered by first arrival.
+template<typename T>
+void RandomTree<T>::bulk_load(const std::vector<T> &a)
+{
+    int n = static_cast<int>(a.size());
+    std::vector<std::pair<T, int>> keys(n);
+    for (int i = 0; i < n; i++)
+        keys[i] = {a[i], i};
+
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end(), [](const std::pair<T, int> &x, const std::pair<T, int> &y) {
+        return !(x.first < y.first) && !(y.first < x.first);
+    }), keys.end());
+
+    // RDP numbers the leaves in arrival order, duplicates do not count
+    std::vector<int> arrival(n, -1);
+    for (auto &k : keys)
+        arrival[k.second] = 0;
+    int next = this->index;
+    for (int i = 0; i < n; i++) {
+        if (arrival[i] == 0)
+            arrival[i] = next++;
+    }
+    this->index = next;
+
+    // right spine of the tree built so far
+    std::vector<std::pair<Leaf<T> *, int>> spine;
+    for (auto &k : keys) {
+        Leaf<T> *last = nullptr;
+        while (!spine.empty() && spine.back().second > k.second) {
+            last = spine.back().first;
+            spine.pop_back();
+        }
+
+        Leaf<T> *p = this->new_leaf(k.first, arrival[k.second]);
+        p->left = last;
+        if (!spine.empty())
+            spine.back().first->right = p;
+        spine.emplace_back(p, k.second);
+    }
+    this->root = spine.empty() ? nullptr : spine.front().first;
+    this->count_sizes(this->root);
+}
+
+template<typename T>
+void RandomTree<T>::RDP(const T &data)
+{
+    Leaf<T> **p = &(this->root);
+    Probe probe(data);
+
+    //Leaf<T> *buf = new Leaf<T>(data, index);
+
+    while (*p != nullptr) {
+        int c = this->compare(probe, *p);
+        if (c < 0) {
+            p = &((*p)->left);
+        }
+        else if (c > 0) {
+            p = &((*p)->right);
+        }
+        else {
+            break;
+        }
+    }
+    if (*p == nullptr) {
+        *p = this->new_leaf(data, this->index++);
+        (*p)->left = nullptr;
+        (*p)->right = nullptr;
+        this->changed(*p);
+        this->resize_path(probe, *p, 1);
+    }
+}
+
+template<typename T>
+void RandomTree<T>::deleteElem(const T &data)
+{
+    Leaf<T> **p = &(this->root);
+    Probe probe(data);
+
+    Leaf<T> *q, *r, *S;
+    Leaf<T> *parent = nullptr;
+
+    while (*p != nullptr) {
+        int c = this->compare(probe, *p);
+        if (c < 0) {
+            parent = *p;
+            p = &((*p)->left);
+        }
+        else if (c > 0) {
+            parent = *p;
+            p = &((*p)->right);
+        }
+        else {
+            break;
+        }
+    }
+    if (*p != nullptr) {
+        q = *p;
+        this->changed(parent);
+        this->resize_path(probe, q, -1);
+        if (q->left == nullptr) {
+            *p = q->right;
+        }
+        else if (q->right == nullptr) {
+            *p = q->left;
+        }
+        else {
+            r = q->left;
+            S = q;
+            if (r->right == nullptr) {
+                r->right = q->right;
+                *p = r;
+            }
+            else {
+                while (r->right != nullptr) {
+                    S = r;
+                    r = r->right;
+#if SUBTREE_SIZES == 1
+                    S->size--;
+#endif
+                }
+                S->right = r->left;
+                r->left = q->left;
+                r->right = q->right;
+                *p = r;
+                this->changed(S);
+            }
+            this->update_size(r);
+            this->changed(r);
+        }
+        this->delete_leaf(q);
+    }
+}
+// RANDOM TREE END
+
+
+template<typename T>
+class AVLTree: public BinTree<T>
+{
+public:
+
+    enum class Load
+    {
+        Insert,      // one AVL() call per key, the shape follows the input order
+        Bulk,        // sort unless already sorted, drop duplicates, build balanced in O(n)
+        ParallelBulk // as Bulk, sorting on all hardware threads
+    };
+
+    explicit AVLTree(const std::vector<T> &vec, const std::string &filename, Load load = Load::Insert)
+    {
+        this->output_filename = filename;
+
+        if (load == Load::Insert) {
+            for (auto p : vec) {
+                AVL(this->root, p);
+            }
+        }
+        else {
+            bulk_load(vec, load == Load::ParallelBulk);
+        }
+    }
+
+    ~AVLTree();
+
+    // the balance factors lead down a longest path, so this takes O(log n) without a walk
+    int tree_height() const
+    {
+        return height(this->root);
+    }
+
+    // the glyphs of drawView() always show heights, the balance factors give them in O(log n)
+    void drawView(const typename BinTree<T>::View &view) const
+    {
+        typename BinTree<T>::View v = view;
+        v.heights = true;
+        this->draw_view(v, height);
+    }
+
+    void addElem(const T &data)
+    {
+        if (concurrent)
+            insert_batch({data});
+        else
+            AVL(this->root, data);
+    }
+
+    void deleteElem(const T &data)
+    {
+        if (concurrent)
+            erase_batch({data});
+        else
+            delElem(data, this->root, down);
+    }
+
+    // Lets other threads read the tree through Readers while one thread writes it. Writes then
+    // copy the leaves they would change, link the copies into a new version of the tree and
+    // publish its root at the end, readers see the versions before and after but nothing in
+    // between. Replaced leaves are freed once no reader can reach them any more. Only addElem,
+    // deleteElem, the batch and the set operations may write meanwhile, none of them forks.
+    // No Reader may be alive while the mode is switched.
+    void concurrent_reads(bool enable);
+
+    // Read access from any thread to the version of the tree published when it was created.
+    // A Reader is meant to be short lived, leaves replaced after its creation are not freed
+    // before it is gone.
+    class Reader
+    {
+    public:
+        explicit Reader(const AVLTree &tree);
+        ~Reader();
+
+        Reader(const Reader &) = delete;
+        Reader &operator=(const Reader &) = delete;
+
+        const Leaf<T> *find(const T &key) const
+        {
+            return AVLTree::find_from(root, key);
+        }
+
+        bool contains(const T &key) const
+        {
+            return find(key) != nullptr;
+        }
+
+        const Leaf<T> *lower_bound(const T &key) const
+        {
+            return AVLTree::lower_bound_from(root, key);
+        }
+
+        const Leaf<T> *upper_bound(const T &key) const
+        {
+            return AVLTree::upper_bound_from(root, key);
+        }
+
+        int count_range(const T &lo, const T &hi) const
+        {
+            return AVLTree::count_range_from(root, lo, hi);
+        }
+
+        int rank(const T &key) const
+        {
+            return AVLTree::rank_from(root, key);
+        }
+
+        const Leaf<T> *select(int k) const
+        {
+            return AVLTree::select_from(root, k);
+        }
+
+    protected:
+        Leaf<T> *root;
+
+    private:
+        std::atomic<int> *count; // reader count of the epoch this reader entered in
+    };
+
+    // Version of the tree taken in O(1) in concurrent mode, it stays as it is while writers go
+    // on: they copy the root paths they change and share the rest with the snapshot. Being a
+    // Reader, a snapshot keeps every leaf replaced during its lifetime, so it is not meant to
+    // be kept for long under heavy writing.
+    class Snapshot: public Reader
+    {
+    public:
+        explicit Snapshot(const AVLTree &tree)
+            : Reader(tree), tree(tree)
+        {
+        }
+
+        void print() const
+        {
+            tree.print_leftToRight(this->root, 10);
+        }
+
+        // the layout of drawGraph without the OGDF path and the kept drawing, so other
+        // threads may draw snapshots while the tree is written
+        void drawGraph(const std::string &filename) const
+        {
+            tree.write_drawing(this->root, filename);
+        }
+
+        typename BinTree<T>::Statistics statistics() const
+        {
+            return AVLTree::statistics_from(this->root);
+        }
+
+    private:
+        const AVLTree &tree;
+    };
+
+    // Insert or erase a whole batch of keys at once. The batch is sorted and merged into
+    // the tree by splitting it at the middle key and joining the halves back, which takes
+    // O(k log(n/k + 1)) for k keys instead of k root-to-leaf passes with their rotations.
+    // Keys already in the tree are skipped by insert_batch, missing ones by erase_batch.
+    void insert_batch(const std::vector<T> &keys);
+    void erase_batch(const std::vector<T> &keys);
+
+    // Set operations with the keys of other, the result replaces this tree and other stays
+    // as it is. The keys of other are merged in the same way as a batch, and both halves of
+    // every split are merged on threads of their own while the ranges stay large.
+    void set_union(const AVLTree &other);
+    void set_intersection(const AVLTree &other);
+    void set_difference(const AVLTree &other);
+
+private:
+    using Probe = typename BinTree<T>::Probe;
+
+    // Insert and delete in place, one root-to-leaf pass with its rotations. They free and
+    // relink leaves that Readers may still hold, so in concurrent mode addElem and
+    // deleteElem go through the batch operations instead. delElem is false if there is no
+    // key x in the subtree of p.
+    bool delElem(const T &x, Leaf<T> *&p, bool &down)
+    {
+        return delElem(Probe(x), p, down);
+    }
+
+    void AVL(Leaf<T> *&p, const T &data)
+    {
+        AVL(p, Probe(data));
+    }
+
+    bool delElem(const Probe &x, Leaf<T> *&p, bool &down);
+    void AVL(Leaf<T> *&p, const Probe &data);
+
+    void del(Leaf<T> *&r, bool &down, Leaf<T> *&q);
+
+    void LLTurn(Leaf<T> **buf);
+
+    void RRTurn(Leaf<T> **buf);
+
+    void LRTurn(Leaf<T> **buf);
+
+    void RLTurn(Leaf<T> **buf);
+
+    void BR(Leaf<T> *&buf, bool &down);
+
+    void BL(Leaf<T> *&buf, bool &down);
+
+    void LL1(Leaf<T> *&buf, bool &down);
+
+    void RR1(Leaf<T> *&buf, bool &down);
+
+    bool rost;
+    bool down = false;
+
+    void bulk_load(const std::vector<T> &vec, bool parallel);
+
+    // Subtree with its height. The join-based operations derive the heights of children
+    // from the balance factors, so the leaves need no height field.
+    struct Tree
+    {
+        Leaf<T> *p;
+        int h;
+    };
+
+    struct Split
+    {
+        Tree left;
+        Leaf<T> *found; // leaf holding the key, nullptr if there is none
+        Tree right;
+    };
+
+    static int height(const Leaf<T> *p);
+    static Tree left_of(Tree t);
+    static Tree right_of(Tree t);
+
+    Tree node(Tree l, Leaf<T> *k, Tree r);
+    Tree join(Tree l, Leaf<T> *k, Tree r);
+    Tree join_right(Tree l, Leaf<T> *k, Tree r);
+    Tree join_left(Tree l, Leaf<T> *k, Tree r);
+    Tree join2(Tree l, Tree r);
+    Split split(Tree t, const Probe &key);
+
+    // The leaves are allocated and freed before and after the merge, so the threads only relink
+    // them. Leaves the merge does not use come back as nullptr, the others keep their indices.
+    void insert_sorted(std::vector<Leaf<T> *> &leaves);
+    // frees p, or in concurrent mode retires it until no reader can reach it
+    void release(Leaf<T> *p);
+    void erase_sorted(const std::vector<T> &keys);
+    void retain_sorted(const std::vector<T> &keys);
+    int fork_depth() const;
+    void delete_subtree(Leaf<T> *p);
+    static std::vector<T> sorted_keys(const Leaf<T> *p);
+
+    // merge the sorted distinct keys[lo, hi) into t
+    Tree insert_range(Tree t, const std::vector<Leaf<T> *> &leaves, int lo, int hi, std::vector<char> &used, int forks);
+    Tree erase_range(Tree t, const std::vector<T> &keys, int lo, int hi, std::vector<Leaf<T> *> &removed, int forks);
+    Tree retain_range(Tree t, const std::vector<T> &keys, int lo, int hi, std::vector<Leaf<T> *> &dropped, int forks);
+
+    // Concurrent mode. Published leaves are never changed: node() links a copy of them instead,
+    // leaves made during the current write are in fresh and are changed in place. A Reader counts
+    // itself in the epoch it enters in; the writer moves on to the next epoch only when no reader
+    // of the one before the current is left, and then frees the leaves retired before that.
+    Leaf<T> *copy_leaf(Leaf<T> *p);
+    void publish();
+    int readers_in(unsigned epoch) const;
+
+    static constexpr int reader_stripes = 16;
+
+    // reader counts of the two last epochs, spread over cache lines by reading thread
+    struct alignas(64) ReaderCount
+    {
+        std::atomic<int> n[2] = {{0}, {0}};
+    };
+
+    bool concurrent = false;
+    std::atomic<Leaf<T> *> published{nullptr};
+    std::atomic<unsigned> epoch{0};
+    mutable ReaderCount readers[reader_stripes];
+    std::unordered_set<Leaf<T> *> fresh;
+    std::vector<Leaf<T> *> retired_now, retired_before; // in the current and the previous epoch
+};
+
+template<typename T>
+void AVLTree<T>::bulk_load(const std::vector<T> &vec, bool parallel)
+{
+    auto equal = [](const T &x, const T &y) {
+        return !(x < y) && !(y < x);
+    };
+
+    if (std::is_sorted(vec.begin(), vec.end())) {
+        if (std::adjacent_find(vec.begin(), vec.end(), equal) == vec.end()) {
+            this->root = this->build_balanced(0, static_cast<int>(vec.size()) - 1, vec);
+            return;
+        }
+    }
+
+    std::vector<T> keys(vec);
+    if (!std::is_sorted(keys.begin(), keys.end())) {
+        if (parallel)
+            parallel_sort(keys);
+        else
+            std::sort(keys.begin(), keys.end());
+    }
+    keys.erase(std::unique(keys.begin(), keys.end(), equal), keys.end());
+    this->root = this->build_balanced(0, static_cast<int>(keys.size()) - 1, keys);
+}
+
+template<typename T>
+AVLTree<T>::~AVLTree()
+{
+    for (auto p : retired_before)
+        this->delete_leaf(p);
+    for (auto p : retired_now)
+        this->delete_leaf(p);
+}
+
+template<typename T>
+void AVLTree<T>::concurrent_reads(bool enable)
+{
+    // without readers everything retired is unreachable
+    for (auto p : retired_before)
+        this->delete_leaf(p);
+    for (auto p : retired_now)
+        this->delete_leaf(p);
+    retired_before.clear();
+    retired_now.clear();
+    fresh.clear();
+
+    concurrent = enable;
+    published.store(enable ? this->root : nullptr);
+}
+
+template<typename T>
+AVLTree<T>::Reader::Reader(const AVLTree &tree)
+{
+    static thread_local const size_t stripe = std::hash<std::thread::id>()(std::this_thread::get_id()) % reader_stripes;
+
+    // the count has to be raised in the epoch that is still current afterwards, otherwise the
+    // writer may have checked it already
+    for (;;) {
+        unsigned e = tree.epoch.load();
+        count = &tree.readers[stripe].n[e & 1];
+        count->fetch_add(1);
+        if (tree.epoch.load() == e)
+            break;
+        count->fetch_sub(1);
+    }
+    root = tree.published.load();
+}
+
+
+template<typename T>
+AVLTree<T>::Reader::~Reader()
+{
+    count->fetch_sub(1);
+}
+
+template<typename T>
+int AVLTree<T>::readers_in(unsigned e) const
+{
+    int n = 0;
+    for (auto &r : readers)
+        n += r.n[e & 1].load();
+    return n;
+}
+
+template<typename T>
+void AVLTree<T>::release(Leaf<T> *p)
+{
+    if (!concurrent) {
+        this->delete_leaf(p);
+        return;
+    }
+
+    // the drawing and the statistics forget the leaf now, as delete_leaf would do
+    this->stats_dirty = true;
+    if (this->drawing != nullptr && p->slot != -1) {
+        this->drawing->retire(p->slot);
+        p->slot = -1;
+    }
+    retired_now.push_back(p);
+}
+
+template<typename T>
+Leaf<T> *AVLTree<T>::copy_leaf(Leaf<T> *p)
+{
+    Leaf<T> *copy = this->new_leaf(p->data, p->index);
+    copy->left = p->left;
+    copy->right = p->right;
+    copy->Bal = p->Bal;
+#if SUBTREE_SIZES == 1
+    copy->size = p->size;
+#endif
+    this->replaced(p, copy);
+    retired_now.push_back(p);
+    fresh.insert(copy);
+    return copy;
+}
+
+template<typename T>
+void AVLTree<T>::publish()
+{
+    fresh.clear();
+    published.store(this->root);
+
+    // Leaves retired in the previous epoch can be held only by readers that entered in it,
+    // which count on the same side as the epoch after the current one.
+    unsigned e = epoch.load();
+    if (readers_in(e + 1) == 0) {
+        for (auto p : retired_before)
+            this->delete_leaf(p);
+        retired_before.swap(retired_now);
+        retired_now.clear();
+        epoch.store(e + 1);
+    }
+}
+
+template<typename T>
+void AVLTree<T>::insert_batch(const std::vector<T> &keys)
+{
+    // first arrival of every key, new leaves are numbered in that order as addElem would do
+    int n = static_cast<int>(keys.size());
+    std::vector<std::pair<T, int>> batch(n);
+    for (int i = 0; i < n; i++)
+        batch[i] = {keys[i], i};
+    parallel_sort(batch);
+    batch.erase(std::unique(batch.begin(), batch.end(), [](const std::pair<T, int> &x, const std::pair<T, int> &y) {
+        return !(x.first < y.first) && !(y.first < x.first);
+    }), batch.end());
+
+    std::vector<Leaf<T> *> leaves(batch.size());
+    for (size_t i = 0; i < batch.size(); i++)
+        leaves[i] = this->new_leaf(batch[i].first, 0);
+    insert_sorted(leaves);
+
+    std::vector<std::pair<int, Leaf<T> *>> arrival;
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (leaves[i] != nullptr)
+            arrival.emplace_back(batch[i].second, leaves[i]);
+    }
+    std::sort(arrival.begin(), arrival.end());
+    for (auto &a : arrival)
+        a.second->index = this->index++;
+}
+
+template<typename T>
+void AVLTree<T>::erase_batch(const std::vector<T> &keys)
+{
+    std::vector<T> batch(keys);
+    parallel_sort(batch);
+    batch.erase(std::unique(batch.begin(), batch.end(), [](const T &x, const T &y) {
+        return !(x < y) && !(y < x);
+    }), batch.end());
+
+    erase_sorted(batch);
+}
+
+template<typename T>
+void AVLTree<T>::set_union(const AVLTree &other)
+{
+    // the keys are copied first, other may be this tree
+    std::vector<T> keys = sorted_keys(other.root);
+    std::vector<Leaf<T> *> leaves(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+        leaves[i] = this->new_leaf(keys[i], 0);
+    insert_sorted(leaves);
+
+    for (auto p : leaves) {
+        if (p != nullptr)
+            p->index = this->index++;
+    }
+}
+
+template<typename T>
+void AVLTree<T>::set_intersection(const AVLTree &other)
+{
+    retain_sorted(sorted_keys(other.root));
+}
+
+template<typename T>
+void AVLTree<T>::set_difference(const AVLTree &other)
+{
+    erase_sorted(sorted_keys(other.root));
+}
 
-            elem_found = false;
-            pchar = s.c_str(); //use char const* as target type
-            GA.label(v) = pchar;
+template<typename T>
+void AVLTree<T>::insert_sorted(std::vector<Leaf<T> *> &leaves)
+{
+    std::vector<char> used(leaves.size(), 0);
+    if (concurrent)
+        fresh.insert(leaves.begin(), leaves.end());
+    this->root = insert_range({this->root, height(this->root)}, leaves, 0, static_cast<int>(leaves.size()), used,
+                              fork_depth()).p;
+    // the new root need not have passed through node(), which marks the statistics stale
+    this->stats_dirty = true;
+
+    for (size_t i = 0; i < leaves.size(); i++) {
+        if (!used[i]) {
+            this->delete_leaf(leaves[i]);
+            leaves[i] = nullptr;
         }
     }
+    if (concurrent)
+        publish();
+}
 
-    for (edge e = G.firstEdge(); e; e = e->succ())// set default edge color and type
-    {
-        GA.bends(e);
-        GA.arrowType(e) = ogdf::EdgeArrow::Last;
-        GA.strokeColor(e) = Color("#0000FF");
+template<typename T>
+void AVLTree<T>::erase_sorted(const std::vector<T> &keys)
+{
+    std::vector<Leaf<T> *> removed(keys.size(), nullptr);
+    this->root = erase_range({this->root, height(this->root)}, keys, 0, static_cast<int>(keys.size()), removed,
+                             fork_depth()).p;
+    // join2() hands back a root untouched when the left part is empty
+    this->stats_dirty = true;
+
+    for (auto p : removed) {
+        if (p != nullptr)
+            release(p);
     }
+    if (concurrent)
+        publish();
+}
 
-    TreeLayout SL; //Compute a hierarchical drawing of G (using SugiyamaLayout)
+template<typename T>
+void AVLTree<T>::retain_sorted(const std::vector<T> &keys)
+{
+    std::vector<Leaf<T> *> dropped;
+    this->root = retain_range({this->root, height(this->root)}, keys, 0, static_cast<int>(keys.size()), dropped,
+                              fork_depth()).p;
+    // an emptied range comes back as a null root without node()
+    this->stats_dirty = true;
+
+    for (auto p : dropped)
+        delete_subtree(p);
+    if (concurrent)
+        publish();
+}
 
-    SL.call(GA);
+// levels of the recursion that still fork, as in build_balanced
+template<typename T>
+int AVLTree<T>::fork_depth() const
+{
+    // a kept drawing records the changed leaves from one thread only, so do the copies of
+    // concurrent mode
+    if (this->drawing != nullptr || concurrent)
+        return 0;
 
-    std::fstream fs(output_filename, std::ios::out);
-    GraphIO::drawSVG(GA, fs);
+    int forks = 0;
+    for (unsigned threads = std::thread::hardware_concurrency(); threads > 1; threads >>= 1)
+        forks++;
+    return forks + 1;
 }
 
 template<typename T>
-ogdf::node BinTree<T>::fill_graph(Leaf *p)
+void AVLTree<T>::delete_subtree(Leaf<T> *p)
 {
-    if (p != nullptr) {
-        node rooted = G.newNode(p->index);
-        G.newEdge(rooted, fill_graph(p->left));
-        G.newEdge(rooted, fill_graph(p->right));
-        return rooted;
-    }
-    else { // если попали на nullptr, то создаем узел дерева без привязки
-        // чтобы избежать неожиданного поведения
-        node s = G.newNode(++this->index);
-        this->NullNodes.push_back(s); // добавляем его в вектор NULL-узлов
-        return s;
+    std::vector<Leaf<T> *> stack;
+    if (p != nullptr)
+        stack.push_back(p);
+    while (!stack.empty()) {
+        p = stack.back();
+        stack.pop_back();
+        if (p->left != nullptr)
+            stack.push_back(p->left);
+        if (p->right != nullptr)
+            stack.push_back(p->right);
+        release(p);
     }
 }
 
+// keys of the subtree in ascending order
 template<typename T>
-Leaf<T>* BinTree<T>::searchElementByIndex(Leaf *p, const int &index)
+std::vector<T> AVLTree<T>::sorted_keys(const Leaf<T> *p)
 {
-    if (p != nullptr) {
-        searchElementByIndex(p->left, index);
-        searchElementByIndex(p->right, index);
-
-        if (p->index == index && !elem_found) {
-            elem_found = true;
-            search_result = p;
-            return search_result;
-        }
-        if (elem_found) {
-            return search_result;
-        }
+    std::vector<T> keys;
+    std::vector<const Leaf<T> *> stack;
+    while (p != nullptr || !stack.empty()) {
+        for (; p != nullptr; p = p->left)
+            stack.push_back(p);
+        p = stack.back();
+        stack.pop_back();
+        keys.push_back(p->data);
+        p = p->right;
     }
-    return nullptr;
+    return keys;
 }
 
+// height of the subtree, following the balance factors down the taller side
 template<typename T>
-class IdealTree: public BinTree<T>
+int AVLTree<T>::height(const Leaf<T> *p)
 {
-public:
-    IdealTree<T>(int L, int R, const std::vector<T> &A, const std::string &filename)
-    {
-        this->output_filename = filename;
-        this->index = 0;
-        BinTree<T>::root = IDSP(L, R, A);
-    }
+    int h = 0;
+    for (; p != nullptr; h++)
+        p = p->Bal < 0 ? p->left : p->right;
+    return h;
+}
 
-    IdealTree<T>(const std::vector<T> &A, const std::string &filename)
-    {
-        this->output_filename = filename;
-        this->index = 0;
-        BinTree<T>::root = IDSP(0, static_cast<int>(A.size() - 1), A);
-    }
-private:
-    Leaf<T> *IDSP(int L, int R, const std::vector<T> &A);
-};
+template<typename T>
+typename AVLTree<T>::Tree AVLTree<T>::left_of(Tree t)
+{
+    return {t.p->left, t.p->Bal < 0 ? t.h - 1 : t.h - 1 - t.p->Bal};
+}
 
 template<typename T>
-Leaf<T> *IdealTree<T>::IDSP(int L, int R, const std::vector<T> &A)
+typename AVLTree<T>::Tree AVLTree<T>::right_of(Tree t)
 {
-    int m;
-    Leaf<T> *p;
+    return {t.p->right, t.p->Bal > 0 ? t.h - 1 : t.h - 1 + t.p->Bal};
+}
 
-    if (L > R)
-        p = nullptr;
-    else {
-        m = (L + R) / 2;
-        Leaf<T> *buf = (new Leaf<T>(A[m], this->index++));
-        p = buf;
+// k with the subtrees l and r, whose heights differ by one at most
+template<typename T>
+typename AVLTree<T>::Tree AVLTree<T>::node(Tree l, Leaf<T> *k, Tree r)
+{
+    if (concurrent && fresh.count(k) == 0)
+        k = copy_leaf(k);
+    k->left = l.p;
+    k->right = r.p;
+    k->Bal = r.h - l.h;
+    this->update_size(k);
+    this->changed(k);
+    return {k, std::max(l.h, r.h) + 1};
+}
 
-        p->left = IDSP(L, m - 1, A);
+// Joins l, k and r, all keys of l being less than k and all keys of r greater.
+// Takes O(|h(l) - h(r)| + 1) time (Blelloch, Ferizovic, Sun, "Just Join for Parallel Ordered Sets").
+template<typename T>
+typename AVLTree<T>::Tree AVLTree<T>::join(Tree l, Leaf<T> *k, Tree r)
+{
+    if (l.h > r.h + 1)
+        return join_right(l, k, r);
+    if (r.h > l.h + 1)
+        return join_left(l, k, r);
+    return node(l, k, r);
+}
 
-        p->right = IDSP(m + 1, R, A);
+// l is the taller one: k and r go down the right spine of l to a subtree about as high as r
+template<typename T>
+typename AVLTree<T>::Tree AVLTree<T>::join_right(Tree l, Leaf<T> *k, Tree r)
+{
+    Leaf<T> *p = l.p;
+    Tree a = left_of(l), c = right_of(l);
+
+    if (c.h <= r.h + 1) {
+        if (std::max(c.h, r.h) <= a.h)
+            return node(a, p, node(c, k, r));
+        // double rotation, c would be the taller child of k
+        Tree c1 = left_of(c), c2 = right_of(c);
+        return node(node(a, p, c1), c.p, node(c2, k, r));
     }
-    return p;
-}
 
-//RANDOM TREE BEGIN
+    Tree t = join_right(c, k, r);
+    if (t.h <= a.h + 1)
+        return node(a, p, t);
+    // single rotation to the left
+    return node(node(a, p, left_of(t)), t.p, right_of(t));
+}
 
 template<typename T>
-class RandomTree: public BinTree<T>
+typename AVLTree<T>::Tree AVLTree<T>::join_left(Tree l, Leaf<T> *k, Tree r)
 {
-public:
-    explicit RandomTree<T>(const std::vector<T> &a, const std::string &filename)
-    {
-        this->output_filename = filename;
-
-        for (int i = 0; i < a.size(); i++)
-            RDP(a[i]);
+    Leaf<T> *p = r.p;
+    Tree c = left_of(r), a = right_of(r);
+
+    if (c.h <= l.h + 1) {
+        if (std::max(l.h, c.h) <= a.h)
+            return node(node(l, k, c), p, a);
+        Tree c1 = left_of(c), c2 = right_of(c);
+        return node(node(l, k, c1), c.p, node(c2, p, a));
     }
-    RandomTree<T>()
-    {};
 
-    void deleteElem(T data);
+    Tree t = join_left(l, k, c);
+    if (t.h <= a.h + 1)
+        return node(t, p, a);
+    return node(left_of(t), t.p, node(right_of(t), p, a));
+}
 
-    void addElem(T data)
-    {
-        RDP(data);
+// joins two trees without a key in between by taking the last leaf of l out
+template<typename T>
+typename AVLTree<T>::Tree AVLTree<T>::join2(Tree l, Tree r)
+{
+    if (l.p == nullptr)
+        return r;
+
+    // the right spine of l, the last leaf comes off and the spine is joined back bottom-up
+    std::vector<Tree> spine;
+    for (Tree t = l; t.p != nullptr; t = right_of(t))
+        spine.push_back(t);
+
+    Leaf<T> *last = spine.back().p;
+    Tree rest = left_of(spine.back());
+    spine.pop_back();
+    while (!spine.empty()) {
+        rest = join(left_of(spine.back()), spine.back().p, rest);
+        spine.pop_back();
     }
-protected:
-    void RDP(T data);
-};
+    return join(rest, last, r);
+}
 
+// splits t into the keys less than key and those greater
 template<typename T>
-void RandomTree<T>::RDP(T data)
+typename AVLTree<T>::Split AVLTree<T>::split(Tree t, const Probe &key)
 {
-    Leaf<T> **p = &(this->root);
-
-    //Leaf<T> *buf = new Leaf<T>(data, index);
-
-    while (*p != nullptr) {
-        if (data < (*p)->data) {
-            p = &((*p)->left);
-        }
-        else if (data > (*p)->data) {
-            p = &((*p)->right);
-        }
-        else {
-            break;
-        }
+    if (t.p == nullptr)
+        return {{nullptr, 0}, nullptr, {nullptr, 0}};
+
+    Leaf<T> *p = t.p;
+    Tree l = left_of(t), r = right_of(t);
+    int c = this->compare(key, p);
+    if (c < 0) {
+        Split s = split(l, key);
+        return {s.left, s.found, join(s.right, p, r)};
     }
-    if (*p == nullptr) {
-        *p = new Leaf<T>(data, this->index++);
-        (*p)->left = nullptr;
-        (*p)->right = nullptr;
+    if (c > 0) {
+        Split s = split(r, key);
+        return {join(l, p, s.left), s.found, s.right};
     }
+    return {l, p, r};
 }
 
+// used[i] is set when leaves[i] went into the tree, its key was not there yet
 template<typename T>
-void RandomTree<T>::deleteElem(T data)
+typename AVLTree<T>::Tree AVLTree<T>::insert_range(Tree t, const std::vector<Leaf<T> *> &leaves, int lo, int hi,
+                                                   std::vector<char> &used, int forks)
 {
-    Leaf<T> **p = &(this->root);
-
-    Leaf<T> *q, *r, *S;
+    if (lo >= hi)
+        return t;
+
+    int mid = lo + (hi - lo) / 2;
+    Split s = split(t, Probe(leaves[mid]->data));
+    Leaf<T> *k = s.found;
+    if (k == nullptr) {
+        k = leaves[mid];
+        used[mid] = 1;
+    }
 
-    while (*p != nullptr) {
-        if (data < (*p)->data) {
-            p = &((*p)->left);
-        }
-        else if (data > (*p)->data) {
-            p = &((*p)->right);
-        }
-        else {
-            break;
-        }
+    Tree l, r;
+    if (forks > 0 && hi - lo >= PARALLEL_CUTOFF) {
+        std::thread worker([&] {
+            l = insert_range(s.left, leaves, lo, mid, used, forks - 1);
+        });
+        r = insert_range(s.right, leaves, mid + 1, hi, used, forks - 1);
+        worker.join();
     }
-    if (*p != nullptr) {
-        q = *p;
-        if (q->left == nullptr) {
-            *p = q->right;
-        }
-        else if (q->right == nullptr) {
-            *p = q->left;
-        }
-        else {
-            r = q->left;
-            S = q;
-            if (r->right == nullptr) {
-                r->right = q->right;
-                *p = r;
-            }
-            else {
-                while (r->right != nullptr) {
-                    S = r;
-                    r = r->right;
-                }
-                S->right = r->left;
-                r->left = q->left;
-                r->right = q->right;
-                *p = r;
-            }
-        }
-        delete (q);
+    else {
+        l = insert_range(s.left, leaves, lo, mid, used, 0);
+        r = insert_range(s.right, leaves, mid + 1, hi, used, 0);
     }
+    return join(l, k, r);
 }
-// RANDOM TREE END
-
 
+// removed[i] gets the leaf that held keys[i]
 template<typename T>
-class AVLTree: public BinTree<T>
+typename AVLTree<T>::Tree AVLTree<T>::erase_range(Tree t, const std::vector<T> &keys, int lo, int hi,
+                                                  std::vector<Leaf<T> *> &removed, int forks)
 {
-public:
-
-    explicit AVLTree(const std::vector<T> &vec, const std::string &filename)
-    {
-        this->output_filename = filename;
-
-        for (auto p : vec) {
-            AVL(this->root, p);
-        }
+    if (lo >= hi || t.p == nullptr)
+        return t;
+
+    int mid = lo + (hi - lo) / 2;
+    Split s = split(t, Probe(keys[mid]));
+    removed[mid] = s.found;
+
+    Tree l, r;
+    if (forks > 0 && hi - lo >= PARALLEL_CUTOFF) {
+        std::thread worker([&] {
+            l = erase_range(s.left, keys, lo, mid, removed, forks - 1);
+        });
+        r = erase_range(s.right, keys, mid + 1, hi, removed, forks - 1);
+        worker.join();
     }
-
-    bool rost;
-
-    void deleteElem(T data)
-    {
-        delElem(data, this->root, down);
+    else {
+        l = erase_range(s.left, keys, lo, mid, removed, 0);
+        r = erase_range(s.right, keys, mid + 1, hi, removed, 0);
     }
+    return join2(l, r);
+}
 
-    void delElem(const T &x, Leaf<T> *&p, bool &down);
-
-    void AVL(Leaf<T> *&p, T data);
-
-    void del(Leaf<T> *&r, bool &down, Leaf<T> *&q);
-
-    void LLTurn(Leaf<T> **buf);
-
-    void RRTurn(Leaf<T> **buf);
-
-    void LRTurn(Leaf<T> **buf);
-
-    void RLTurn(Leaf<T> **buf);
-
-    void BR(Leaf<T> *&buf, bool &down);
-
-    void BL(Leaf<T> *&buf, bool &down);
-
-    void LL1(Leaf<T> *&buf, bool &down);
-
-    void RR1(Leaf<T> *&buf, bool &down);
+// keeps the keys of t that are in keys[lo, hi), dropped gets the roots of the subtrees cut off
+template<typename T>
+typename AVLTree<T>::Tree AVLTree<T>::retain_range(Tree t, const std::vector<T> &keys, int lo, int hi,
+                                                   std::vector<Leaf<T> *> &dropped, int forks)
+{
+    if (t.p == nullptr)
+        return t;
+    if (lo >= hi) {
+        dropped.push_back(t.p);
+        return {nullptr, 0};
+    }
 
-    bool down = false;
-};
+    int mid = lo + (hi - lo) / 2;
+    Split s = split(t, Probe(keys[mid]));
+
+    Tree l, r;
+    if (forks > 0 && hi - lo >= PARALLEL_CUTOFF) {
+        std::vector<Leaf<T> *> left_dropped;
+        std::thread worker([&] {
+            l = retain_range(s.left, keys, lo, mid, left_dropped, forks - 1);
+        });
+        r = retain_range(s.right, keys, mid + 1, hi, dropped, forks - 1);
+        worker.join();
+        dropped.insert(dropped.end(), left_dropped.begin(), left_dropped.end());
+    }
+    else {
+        l = retain_range(s.left, keys, lo, mid, dropped, 0);
+        r = retain_range(s.right, keys, mid + 1, hi, dropped, 0);
+    }
+    return s.found != nullptr ? join(l, s.found, r) : join2(l, r);
+}
 
 template<typename T>
-void AVLTree<T>::AVL(Leaf<T> *&p, T data)
+void AVLTree<T>::AVL(Leaf<T> *&p, const Probe &data)
 {
     if (p == nullptr) {
-        p = new Leaf<T>(data, this->index++);
+        p = this->new_leaf(data.key, this->index++);
         p->left = nullptr;
         p->right = nullptr;
         p->Bal = 0;
         rost = true;
+        this->changed(p);
     }
     else {
-        if (p->data > data) {
+        int c = this->compare(data, p);
+        if (c < 0) {
             AVL(p->left, data);
             if (rost) {
                 if (p->Bal > 0) {
@@ -477,7 +2949,7 @@ void AVLTree<T>::AVL(Leaf<T> *&p, T data)
             }
         }
         else {
-            if (p->data < data) {
+            if (c > 0) {
                 AVL(p->right, data);
                 if (rost) {
                     if (p->Bal < 0) {
@@ -502,7 +2974,11 @@ void AVLTree<T>::AVL(Leaf<T> *&p, T data)
                     }
                 }
             }
+            else {
+                rost = false; // key is already in the tree
+            }
         }
+        this->update_size(p);
     }
 }
 
@@ -512,10 +2988,14 @@ void AVLTree<T>::LLTurn(Leaf<T> **buf)
     auto **p = &(*buf);
     Leaf<T> *q;
     q = (*p)->left;
+    this->changed(*p);
+    this->changed(q);
     (*p)->Bal = 0;
     q->Bal = 0;
     (*p)->left = q->right;
     q->right = *p;
+    this->update_size(*p);
+    this->update_size(q);
     *p = q;
 }
 
@@ -525,10 +3005,14 @@ void AVLTree<T>::RRTurn(Leaf<T> **buf)
     Leaf<T> **p = &(*buf);
     Leaf<T> *q;
     q = (*p)->right;
+    this->changed(*p);
+    this->changed(q);
     (*p)->Bal = 0;
     q->Bal = 0;
     (*p)->right = q->left;
     q->left = (*p);
+    this->update_size(*p);
+    this->update_size(q);
     (*p) = q;
 }
 
@@ -539,6 +3023,9 @@ void AVLTree<T>::LRTurn(Leaf<T> **buf)
     Leaf<T> *q, *r;
     q = (*p)->left;
     r = q->right;
+    this->changed(*p);
+    this->changed(q);
+    this->changed(r);
     if (r->Bal < 0) {
         (*p)->Bal = 1;
     }
@@ -551,10 +3038,14 @@ void AVLTree<T>::LRTurn(Leaf<T> **buf)
     else {
         q->Bal = 0;
     }
+    r->Bal = 0;
     q->right = r->left;
     (*p)->left = r->right;
     r->left = q;
     r->right = (*p);
+    this->update_size(q);
+    this->update_size(*p);
+    this->update_size(r);
     (*p) = r;
 }
 
@@ -565,22 +3056,29 @@ void AVLTree<T>::RLTurn(Leaf<T> **buf)
     Leaf<T> *q, *r;
     q = (*p)->right;
     r = q->left;
-    if (r->Bal < 0) {
-        (*p)->Bal = 1;
+    this->changed(*p);
+    this->changed(q);
+    this->changed(r);
+    if (r->Bal > 0) {
+        (*p)->Bal = -1;
     }
     else {
         (*p)->Bal = 0;
     }
-    if (r->Bal > 0) {
-        q->Bal = -1;
+    if (r->Bal < 0) {
+        q->Bal = 1;
     }
     else {
         q->Bal = 0;
     }
+    r->Bal = 0;
     q->left = r->right;
     (*p)->right = r->left;
     r->right = q;
     r->left = (*p);
+    this->update_size(q);
+    this->update_size(*p);
+    this->update_size(r);
     (*p) = r;
 }
 
@@ -613,8 +3111,8 @@ void AVLTree<T>::BL(Leaf<T> *&buf, bool &down)
         down = false;
     }
     else if (buf->Bal == 1) {
-        if (buf->left != nullptr) {
-            if (buf->left->Bal >= 0)
+        if (buf->right != nullptr) {
+            if (buf->right->Bal >= 0)
                 RR1(buf, down);
             else
                 RLTurn(&buf);
@@ -626,28 +3124,34 @@ template<typename T>
 void AVLTree<T>::LL1(Leaf<T> *&buf, bool &down)
 {
     Leaf<T> *q = buf->left;
+    this->changed(buf);
+    this->changed(q);
     if (q->Bal == 0) {
-        buf->Bal = 1;
-        q->Bal = -1;
+        buf->Bal = -1;
+        q->Bal = 1;
         down = false;
     }
     else {
         buf->Bal = 0;
         q->Bal = 0;
-        buf->left = q->right;
-        q->right = buf;
-        buf = q;
     }
+    buf->left = q->right;
+    q->right = buf;
+    this->update_size(buf);
+    this->update_size(q);
+    buf = q;
 }
 
 template<typename T>
 void AVLTree<T>::RR1(Leaf<T> *&buf, bool &down)
 {
     Leaf<T> *q = buf->right;
+    this->changed(buf);
+    this->changed(q);
 
     if (q->Bal == 0) {
         buf->Bal = 1;
-        q->Bal = 1;
+        q->Bal = -1;
         down = false;
     }
     else {
@@ -656,18 +3160,23 @@ void AVLTree<T>::RR1(Leaf<T> *&buf, bool &down)
     }
     buf->right = q->left;
     q->left = buf;
+    this->update_size(buf);
+    this->update_size(q);
     buf = q;
 }
 
 template<typename T>
 void AVLTree<T>::del(Leaf<T> *&r, bool &down, Leaf<T> *&q)
 {
+    this->changed(r);
     if (r->right != nullptr) {
         del(r->right, down, q);
         if (down)
             BR(r, down);
+        this->update_size(r);
     }
     else {
+        q->prefix = r->prefix;
         q->data = r->data;
         q = r;
         r = r->left;
@@ -676,30 +3185,29 @@ void AVLTree<T>::del(Leaf<T> *&r, bool &down, Leaf<T> *&q)
 }
 
 template<typename T>
-void AVLTree<T>::delElem(const T &x, Leaf<T> *&p, bool &down)
+bool AVLTree<T>::delElem(const Probe &x, Leaf<T> *&p, bool &down)
 {
-    Leaf<T> *q, *r;
-
     if (p == nullptr) {
-        std::cout << "No key found!" << std::endl;
-        return;
+        down = false;
+        return false;
     }
-    else if (p->data > x) {
-        delElem(x, p->left, down);
-        if (down) {
-            std::cout << "BL - rotation" << std::endl;
+
+    // any leaf on the path may lose a child or get another one
+    this->changed(p);
+    bool found = true;
+    int c = this->compare(x, p);
+    if (c < 0) {
+        found = delElem(x, p->left, down);
+        if (down)
             BL(p, down);
-        }
     }
-    else if (p->data < x) {
-        delElem(x, p->right, down);
-        if (down) {
-            std::cout << "BR - rotation" << std::endl;
+    else if (c > 0) {
+        found = delElem(x, p->right, down);
+        if (down)
             BR(p, down);
-        }
     }
     else {
-        q = p;
+        Leaf<T> *q = p;
         if (q->right == nullptr) {
             p = q->left;
             down = true;
@@ -710,30 +3218,69 @@ void AVLTree<T>::delElem(const T &x, Leaf<T> *&p, bool &down)
         }
         else {
             del(q->left, down, q);
-            if (down) {
-                std::cout << "BL - rotation" << std::endl;
+            if (down)
                 BL(p, down);
-            }
         }
-        delete q;
+        this->delete_leaf(q);
     }
+    if (p != nullptr)
+        this->update_size(p);
+    return found;
 }
 
 // AVL TREE END
 
 // OPTIMAL SEARCH TREE
 
+#define OPTIMAL_EXACT_LIMIT 8192 // larger inputs use the approximate builder unless asked otherwise
+
 template<typename T>
 class OptimalTree: public RandomTree<T>
 {
 public:
+    enum class Method
+    {
+        Auto,       // Exact up to OPTIMAL_EXACT_LIMIT keys, Approximate above
+        Exact,      // Knuth's dynamic programming, O(n^2) time and memory
+        Approximate // Mehlhorn's weight bisection, O(n log n), at most entropy + 2 comparisons per search
+    };
+
+    // every key weighs its own value, repeated keys add up
     explicit OptimalTree(const std::vector<T> &vec, const std::string &filename);
 
+    // (key, access frequency) pairs in any order, frequencies of repeated keys add up
+    explicit OptimalTree(const std::vector<std::pair<T, int64_t>> &frequencies, const std::string &filename,
+                         Method method = Method::Auto);
+
+    // average number of compared keys per search, weighted by the frequencies
+    double expected_cost() const
+    {
+        return cost;
+    }
+
 private:
-    int **AW, **AR, **AP;
-    void perform_creation(int L, int R, const std::vector<T> &V);
-    void output_debug();
-    int size_n = 0;
+    void build(std::vector<std::pair<T, int64_t>> frequencies, Method method);
+
+    // Knuth's O(n^2) dynamic programming over sorted distinct keys. Only the cost
+    // triangle is kept, the root table needs two columns at a time because roots are
+    // recovered from the costs while linking the tree.
+    void build_exact(const std::vector<T> &keys, const std::vector<int64_t> &AW);
+    // root of every range is the key holding its weighted median
+    void build_approximate(const std::vector<T> &keys, const std::vector<int64_t> &AW);
+
+    // links the tree in preorder, root(i, j) picks the root among keys i+1..j
+    template<class Root>
+    void link(const std::vector<T> &keys, const std::vector<int64_t> &AW, Root root);
+
+    static void output_debug(const std::vector<int64_t> &AW, const std::vector<int64_t> &AP);
+
+    // cost triangle in column-major order, entry (i, j) for 0 <= i <= j <= n
+    static size_t cell(size_t i, size_t j)
+    {
+        return j * (j + 1) / 2 + i;
+    }
+
+    double cost = 0;
 };
 
 template<typename T>
@@ -741,104 +3288,157 @@ OptimalTree<T>::OptimalTree(const std::vector<T> &vec, const std::string &filena
 {
     this->output_filename = filename;
 
-    int n = vec.size();
-    this->size_n = n;
+    std::vector<std::pair<T, int64_t>> frequencies;
+    frequencies.reserve(vec.size());
+    for (auto &k : vec)
+        frequencies.emplace_back(k, static_cast<int64_t>(k));
 
-    AW = new int *[n];
-    AR = new int *[n];
-    AP = new int *[n];
+    build(std::move(frequencies), Method::Exact);
+}
 
-    for (int i = 0; i < n; i++) {
-        AW[i] = new int[n];
-        AP[i] = new int[n];
-        AR[i] = new int[n];
-    }
+template<typename T>
+OptimalTree<T>::OptimalTree(const std::vector<std::pair<T, int64_t>> &frequencies, const std::string &filename,
+                            Method method)
+{
+    this->output_filename = filename;
+    build(frequencies, method);
+}
 
-    //AW matrix calculation
-    int i, j;
-    for (i = 0; i < n; i++) {
-        for (j = i + 1; j < n; j++) {
-            AW[i][j] = 0;
-            AP[i][j] = 0;
-            AR[i][j] = 0;
+template<typename T>
+void OptimalTree<T>::build(std::vector<std::pair<T, int64_t>> frequencies, Method method)
+{
+    std::sort(frequencies.begin(), frequencies.end(), [](const std::pair<T, int64_t> &a, const std::pair<T, int64_t> &b) {
+        return a.first < b.first;
+    });
+
+    std::vector<T> keys;
+    std::vector<int64_t> AW{0}; // AW[j] - AW[i] is the weight of keys i+1..j (1-based)
+    for (auto &f : frequencies) {
+        if (!keys.empty() && !(keys.back() < f.first)) {
+            AW.back() += f.second;
         }
-    }
-
-    for (i = 0; i < n; i++) {
-        for (j = i + 1; j < n; j++) {
-            AW[i][j] = AW[i][j - 1] + vec[j];
+        else {
+            keys.push_back(f.first);
+            AW.push_back(AW.back() + f.second);
         }
     }
+    if (keys.empty())
+        return;
 
-    //AP & AR matrix calculation
-
-    int h = 0;
-
-    for (i = 0; i < n; i++) {
-        j = i + 1;
-        AP[i][j] = AW[i][j];
-        AR[i][j] = j;
-    }
-
-    int m, min, k, x;
+    if (method == Method::Auto)
+        method = keys.size() <= OPTIMAL_EXACT_LIMIT ? Method::Exact : Method::Approximate;
 
-    for (h = 1; h < n; h++) {
-        for (i = 0; i < n - h; i++) {
-            j = i + h + 1;
-            m = AR[i][j - 1];
-            min = AP[i][m - 1] + AP[m][j];
+    if (method == Method::Exact)
+        build_exact(keys, AW);
+    else
+        build_approximate(keys, AW);
+}
 
-            for (k = m; k < AR[i + 1][j]; k++) {
-                x = AP[i][k - 1] + AP[k][j];
+template<typename T>
+void OptimalTree<T>::build_exact(const std::vector<T> &keys, const std::vector<int64_t> &AW)
+{
+    size_t n = keys.size();
+
+    // AP(i, j) is the cost of the optimal tree over keys i+1..j, AP(i, i) = 0.
+    // Columns are filled left to right and every column bottom-up, so AP(k, j) for the
+    // candidate roots k is contiguous and the window bounds AR(i, j-1) and AR(i+1, j)
+    // come from the previous and the current column.
+    std::vector<int64_t> AP((n + 1) * (n + 2) / 2, 0);
+    std::vector<uint32_t> AR_prev(n + 1), AR(n + 1);
+
+    for (size_t j = 1; j <= n; j++) {
+        AP[cell(j - 1, j)] = AW[j] - AW[j - 1];
+        AR[j - 1] = static_cast<uint32_t>(j);
+
+        const int64_t *column = &AP[cell(0, j)];
+        for (size_t i = j - 1; i-- > 0;) {
+            uint32_t m = AR_prev[i];
+            int64_t min = AP[cell(i, m - 1)] + column[m];
+            for (uint32_t k = m + 1; k <= AR[i + 1]; k++) {
+                int64_t x = AP[cell(i, k - 1)] + column[k];
                 if (x < min) {
                     m = k;
                     min = x;
                 }
             }
 
-            AP[i][j] = min + AW[i][j];
-            AR[i][j] = m;
+            AP[cell(i, j)] = min + AW[j] - AW[i];
+            AR[i] = m;
         }
+        std::swap(AR_prev, AR);
     }
 
-    perform_creation(0, n - 1, vec);
+    // the root of keys i+1..j is the first k whose split reproduces AP(i, j)
+    link(keys, AW, [&](size_t i, size_t j) {
+        int64_t split = AP[cell(i, j)] - (AW[j] - AW[i]);
+        size_t k = i + 1;
+        while (AP[cell(i, k - 1)] + AP[cell(k, j)] != split)
+            k++;
+        return k;
+    });
+}
+
+template<typename T>
+void OptimalTree<T>::build_approximate(const std::vector<T> &keys, const std::vector<int64_t> &AW)
+{
+    link(keys, AW, [&](size_t i, size_t j) {
+        // first key whose prefix reaches half of the range weight
+        int64_t half = AW[i] + (AW[j] - AW[i]) / 2;
+        size_t k = std::lower_bound(AW.begin() + i + 1, AW.begin() + j, half) - AW.begin();
+        return k;
+    });
 }
 
 template<typename T>
-void OptimalTree<T>::perform_creation(int L, int R, const std::vector<T> &V)
+template<class Root>
+void OptimalTree<T>::link(const std::vector<T> &keys, const std::vector<int64_t> &AW, Root root)
 {
-    int k = 0;
-    if (L < R) {
-        k = AR[L][R];
-        this->addElem(V[k - 1]);
+    struct Range
+    {
+        size_t i, j;
+        Leaf<T> **slot;
+        int depth;
+    };
+
+    double weighted_depth = 0;
+    std::vector<Range> stack{{0, keys.size(), &this->root, 1}};
+    while (!stack.empty()) {
+        Range r = stack.back();
+        stack.pop_back();
 
-        perform_creation(L, k - 1, V);
-        perform_creation(k, R, V);
+        size_t k = root(r.i, r.j);
+        weighted_depth += double(AW[k] - AW[k - 1]) * r.depth;
+
+        Leaf<T> *p = this->new_leaf(keys[k - 1], this->index++);
+#if SUBTREE_SIZES == 1
+        p->size = static_cast<int>(r.j - r.i);
+#endif
+        *r.slot = p;
+        if (k < r.j)
+            stack.push_back({k, r.j, &p->right, r.depth + 1});
+        if (r.i < k - 1)
+            stack.push_back({r.i, k - 1, &p->left, r.depth + 1});
     }
+
+    cost = AW.back() > 0 ? weighted_depth / AW.back() : 0;
 }
 
 template<typename T>
-void OptimalTree<T>::output_debug()
+void OptimalTree<T>::output_debug(const std::vector<int64_t> &AW, const std::vector<int64_t> &AP)
 {
-    std::cout << "AR matrix" << std::endl << std::setw(6);
-    for (int i = 0; i < size_n; i++) {
-        for (int j = 0; j < size_n; j++) {
-            std::cout << AR[i][j] << std::setw(6);
-        }
-        std::cout << std::endl;
-    }
+    size_t n = AW.size() - 1;
 
-    std::cout << "AP matrix" << std::endl << std::setw(6);;
-    for (int i = 0; i < size_n; i++) {
-        for (int j = 0; j < size_n; j++) {
-            std::cout << AP[i][j] << std::setw(6);
+    std::cout << "AP matrix" << std::endl;
+    for (size_t i = 0; i <= n; i++) {
+        for (size_t j = 0; j <= n; j++) {
+            std::cout << std::setw(6) << (j < i ? 0 : AP[cell(i, j)]);
         }
         std::cout << std::endl;
     }
-    std::cout << "AW matrix" << std::endl << std::setw(6);;
-    for (int i = 0; i < size_n; i++) {
-        for (int j = 0; j < size_n; j++) {
-            std::cout << AW[i][j] << std::setw(6);
+    std::cout << "AW matrix" << std::endl;
+    for (size_t i = 0; i <= n; i++) {
+        for (size_t j = 0; j <= n; j++) {
+            std::cout << std::setw(6) << (j < i ? 0 : AW[j] - AW[i]);
         }
         std::cout << std::endl;
     }
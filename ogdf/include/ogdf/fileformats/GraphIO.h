@@ -70,6 +70,7 @@ public:
 		int    m_fontSize;
 		double m_curviness;
 		bool m_bezierInterpolation;
+		bool m_streaming;
 		string m_fontColor;
 		string m_fontFamily;
 		string m_width;
@@ -81,6 +82,9 @@ public:
 		//! Returns whether Bézier-interpolation for curved edges is enabled.
 		bool bezierInterpolation() const { return m_bezierInterpolation; }
 
+		//! Returns whether the SVG is written directly to the stream instead of being built as a document first.
+		bool streaming() const { return m_streaming; }
+
 		//! Returns the size of the margin around the drawing.
 		double margin() const { return m_margin; }
 
@@ -116,6 +120,13 @@ public:
 		//! Enables or disables Bézier-interpolation.
 		void bezierInterpolation(bool enable) { m_bezierInterpolation = enable; }
 
+		//! Enables or disables streaming output.
+		/**
+		 * Streaming output produces the same bytes as the default document-based output
+		 * but only keeps the currently open elements in memory.
+		 */
+		void streaming(bool enable) { m_streaming = enable; }
+
 		//! Sets the default font size (font height in pixels) to \p fs.
 		void fontSize(int fs) { m_fontSize = fs; }
 
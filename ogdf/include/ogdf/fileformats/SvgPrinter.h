@@ -31,7 +31,7 @@
 
 #pragma once
 
-#include <list>
+#include <vector>
 #include <sstream>
 #include <ogdf/lib/pugixml/pugixml.h>
 #include <ogdf/fileformats/GraphIO.h>
@@ -52,6 +52,66 @@ class SvgPrinter
 {
 public:
 
+	/**
+	 * \brief Straight-line drawing given by coordinates instead of GraphAttributes.
+	 *
+	 * Lets code that lays out its own data structures write the layout in the same markup
+	 * as SvgPrinter::draw() without building a Graph first. Nodes and edges are numbered
+	 * from 0 and drawn in that order. The drawing is written like a directed graph with
+	 * node styles, edge styles and node labels: every edge is a straight line from the
+	 * center of its source to the border of its target, where it ends in an arrow head.
+	 */
+	class StraightLineDrawing
+	{
+	public:
+		virtual ~StraightLineDrawing() { }
+
+		//! Returns the number of nodes.
+		virtual int numberOfNodes() const = 0;
+
+		//! Returns the number of edges.
+		virtual int numberOfEdges() const = 0;
+
+		//! Returns the x-coordinate of the center of node \p v.
+		virtual double x(int v) const = 0;
+
+		//! Returns the y-coordinate of the center of node \p v.
+		virtual double y(int v) const = 0;
+
+		//! Returns the width of node \p v.
+		virtual double width(int v) const = 0;
+
+		//! Returns the height of node \p v.
+		virtual double height(int v) const = 0;
+
+		//! Returns the shape of node \p v.
+		virtual Shape shape(int v) const = 0;
+
+		//! Returns the fill color of node \p v.
+		virtual Color fillColor(int v) const = 0;
+
+		//! Returns the stroke color of a node, black unless overridden.
+		virtual Color strokeColor(int) const { return Color(Color::Name::Black); }
+
+		//! Returns the stroke width of a node, 1 unless overridden.
+		virtual float strokeWidth(int) const { return 1.0f; }
+
+		//! Returns the label of node \p v.
+		virtual std::string label(int v) const = 0;
+
+		//! Returns the source node of edge \p e.
+		virtual int source(int e) const = 0;
+
+		//! Returns the target node of edge \p e.
+		virtual int target(int e) const = 0;
+
+		//! Returns the stroke color of an edge, black unless overridden.
+		virtual Color edgeStrokeColor(int) const { return Color(Color::Name::Black); }
+
+		//! Returns the stroke width of an edge, 1 unless overridden.
+		virtual float edgeStrokeWidth(int) const { return 1.0f; }
+	};
+
 	/**
 	 * Creates a new SVG Printer for a ogdf::Graph.
 	 *
@@ -85,7 +145,39 @@ public:
 	 */
 	bool draw(std::ostream &os);
 
+	/**
+	 * Prints a drawing given by coordinates to the given output stream.
+	 *
+	 * The output is the same as that of draw() for a directed graph with these nodes and
+	 * edges, their coordinates, sizes, shapes, colors and labels.
+	 *
+	 * @param os The stream to print to
+	 * @param drawing The drawing to be printed
+	 * @param settings The SVG configuration
+	 */
+	static bool draw(std::ostream &os, const StraightLineDrawing &drawing, const GraphIO::SVGSettings &settings);
+
 private:
+	//! Text of path data and point lists, formats numbers faster than a std::stringstream.
+	class PathStream;
+
+	//! Geometry of one end of an edge.
+	struct EdgeEnd {
+		DPoint center;    //!< center of the node at this end
+		double width;     //!< width of the node
+		double height;    //!< height of the node
+		double arrowSize; //!< size of an arrow head facing the node
+		bool arrow;       //!< whether an arrow head is drawn at this end
+	};
+
+	//! Stroke of an edge.
+	struct LineStyle {
+		bool styled;     //!< whether the edge has a style; if not, it is drawn solid and black
+		StrokeType type; //!< type of the stroke
+		Color color;     //!< color of the stroke
+		float width;     //!< width of the stroke
+	};
+
 	//! attributes of the graph to be visualized
 	const GraphAttributes &m_attr;
 
@@ -95,19 +187,45 @@ private:
 	//! SVG configuration
 	const GraphIO::SVGSettings &m_settings;
 
+	/**
+	 * Writes the whole drawing below the document node \p doc.
+	 *
+	 * All drawing methods are templates over the XML node type. They are instantiated for
+	 * \c pugi::xml_node, building a document in memory, and for a node type that writes
+	 * every element to the output stream as soon as it is appended. Elements are only ever
+	 * appended to the most recently appended element or one of its ancestors, and attributes
+	 * only to the most recently appended element, so both produce the same bytes.
+	 *
+	 * \param doc the document node
+	 */
+	template<class XmlNode>
+	void drawDocument(XmlNode doc);
+
+	/**
+	 * Writes a drawing given by coordinates below the document node \p doc.
+	 *
+	 * \param doc the document node
+	 * \param drawing the drawing to be printed
+	 * \param settings the SVG configuration
+	 */
+	template<class XmlNode>
+	static void drawDocument(XmlNode doc, const StraightLineDrawing &drawing, const GraphIO::SVGSettings &settings);
+
 	/**
 	 * Draws a rectangle for each cluster in the ogdf::ClusterGraph.
 	 *
 	 * \param xmlNode the XML-node to print to
 	 */
-	void drawClusters(pugi::xml_node xmlNode);
+	template<class XmlNode>
+	void drawClusters(XmlNode xmlNode);
 
 	/**
 	 * Draws a sequence of lines for each edge in the graph.
 	 *
 	 * \param xmlNode the XML-node to print to
 	 */
-	void drawEdges(pugi::xml_node xmlNode);
+	template<class XmlNode>
+	void drawEdges(XmlNode xmlNode);
 
 	/**
 	 * Draws a sequence of lines for an edge.
@@ -116,7 +234,25 @@ private:
 	 * \param xmlNode the XML-node to print to
 	 * \param e the edge to be visualized
 	 */
-	void drawEdge(pugi::xml_node xmlNode, edge e);
+	template<class XmlNode>
+	void drawEdge(XmlNode xmlNode, edge e);
+
+	/**
+	 * Draws the part of a path between two nodes that lies outside of them.
+	 * Arrow heads are added at the ends that request one.
+	 *
+	 * \param xmlNode the XML-node to print to
+	 * \param path the path from the center of the source to the center of the target
+	 * \param source the source end of the edge
+	 * \param target the target end of the edge
+	 * \param label the label of the edge, \c nullptr if there is none
+	 * \param style the stroke of the edge
+	 * \param settings the SVG configuration
+	 * \return false if the nodes overlap and no line was drawn
+	 */
+	template<class XmlNode>
+	static bool drawEdge(XmlNode xmlNode, const DPolyline &path, const EdgeEnd &source, const EdgeEnd &target,
+	                     const char *label, const LineStyle &style, const GraphIO::SVGSettings &settings);
 
 	/**
 	 * Draws the curve depicting a particular edge.
@@ -127,10 +263,12 @@ private:
 	 *
 	 * \param xmlNode the XML-node to print to
 	 * \param points the points along the curve
-	 * \param e the edge depicted by the curve
+	 * \param style the stroke of the curve
+	 * \param settings the SVG configuration
 	 * \return the XML-node of the curve
 	 */
-	pugi::xml_node drawCurve(pugi::xml_node xmlNode, edge e, List<DPoint> &points);
+	template<class XmlNode>
+	static XmlNode drawCurve(XmlNode xmlNode, List<DPoint> &points, const LineStyle &style, const GraphIO::SVGSettings &settings);
 
 	/**
 	 * Draws the path corresponding to a single line to the stream.
@@ -139,23 +277,25 @@ private:
 	 * \param p1 the first point of the line
 	 * \param p2 the second point of the line
 	 */
-	void drawLine(std::stringstream &ss, const DPoint &p1, const DPoint &p2);
+	static void drawLine(PathStream &ss, const DPoint &p1, const DPoint &p2);
 
 	/**
 	 * Draws a list of points using cubic Bézier interpolation.
 	 *
 	 * \param ss the output stream
 	 * \param points the points to be connected by lines
+	 * \param curviness the curviness of the path
 	 */
-	void drawBezierPath(std::stringstream &ss, List<DPoint> &points);
+	static void drawBezierPath(PathStream &ss, List<DPoint> &points, double curviness);
 
 	/**
 	 * Draws a list of points as straight lines connected by circular arcs.
 	 *
 	 * \param ss the output stream
 	 * \param points the points to be connected by lines
+	 * \param curviness the curviness of the path
 	 */
-	void drawRoundPath(std::stringstream &ss, List<DPoint> &points);
+	static void drawRoundPath(PathStream &ss, List<DPoint> &points, double curviness);
 
 	/**
 	 * Draws a list of points as straight lines.
@@ -163,7 +303,7 @@ private:
 	 * \param ss the output stream
 	 * \param points the points to be connected by lines
 	 */
-	void drawLines(std::stringstream &ss, List<DPoint> &points);
+	static void drawLines(PathStream &ss, List<DPoint> &points);
 
 	/**
 	 * Draws a cubic Bezíer path.
@@ -174,22 +314,35 @@ private:
 	 * \param c1 the first control point of the line
 	 * \param c2 the second control point of the line
 	 */
-	void drawBezier(std::stringstream &ss, const DPoint &p1, const DPoint &p2, const DPoint &c1, const DPoint &c2);
+	static void drawBezier(PathStream &ss, const DPoint &p1, const DPoint &p2, const DPoint &c1, const DPoint &c2);
 
 	/**
 	 * Draws all nodes of the graph.
 	 *
 	 * \param xmlNode the XML-node to print to
 	 */
-	void drawNodes(pugi::xml_node xmlNode);
+	template<class XmlNode>
+	void drawNodes(XmlNode xmlNode);
 
 	/**
 	 * Writes the header including the bounding box as the viewport.
 	 *
-	 * \param doc the XML-document
+	 * \param doc the document node
+	 * \return the root SVG-node
+	 */
+	template<class XmlNode>
+	XmlNode writeHeader(XmlNode doc);
+
+	/**
+	 * Writes the header with the given bounding box as the viewport.
+	 *
+	 * \param doc the document node
+	 * \param box the bounding box of the drawing
+	 * \param settings the SVG configuration
 	 * \return the root SVG-node
 	 */
-	pugi::xml_node writeHeader(pugi::xml_document &doc);
+	template<class XmlNode>
+	static XmlNode writeHeader(XmlNode doc, const DRect &box, const GraphIO::SVGSettings &settings);
 
 	/**
 	 * Generates a string that describes the requested dash type.
@@ -198,7 +351,8 @@ private:
 	 * \param lineStyle specifies the style of the dashes
 	 * \param lineWidth the stroke width of the respective edge
 	 */
-	void writeDashArray(pugi::xml_node xmlNode, StrokeType lineStyle, double lineWidth);
+	template<class XmlNode>
+	static void writeDashArray(XmlNode xmlNode, StrokeType lineStyle, double lineWidth);
 
 	/**
 	 * Draws a single node.
@@ -206,7 +360,46 @@ private:
 	 * \param xmlNode the XML-node to print to
 	 * \param v the node to be printed
 	 */
-	void drawNode(pugi::xml_node xmlNode, node v);
+	template<class XmlNode>
+	void drawNode(XmlNode xmlNode, node v);
+
+	/**
+	 * Draws the shape of a node.
+	 *
+	 * \param xmlNode the XML-node to print to
+	 * \param shape the shape of the node
+	 * \param x the x-coordinate of the center of the node
+	 * \param y the y-coordinate of the center of the node
+	 * \param width the width of the node
+	 * \param height the height of the node
+	 * \return the XML-node of the shape
+	 */
+	template<class XmlNode>
+	static XmlNode drawShape(XmlNode xmlNode, Shape shape, double x, double y, double width, double height);
+
+	/**
+	 * Writes the fill and stroke of a node to the XML-node of its shape.
+	 *
+	 * \param shape the XML-node of the shape
+	 * \param fillColor the fill color of the node
+	 * \param strokeType the stroke type of the node
+	 * \param strokeColor the stroke color of the node
+	 * \param strokeWidth the stroke width of the node
+	 */
+	template<class XmlNode>
+	static void appendNodeStyle(XmlNode shape, const Color &fillColor, StrokeType strokeType, const Color &strokeColor, float strokeWidth);
+
+	/**
+	 * Draws the label of a node.
+	 *
+	 * \param xmlNode the XML-node to print to
+	 * \param x the x-coordinate of the center of the label
+	 * \param y the y-coordinate of the center of the label
+	 * \param label the text of the label
+	 * \param settings the SVG configuration
+	 */
+	template<class XmlNode>
+	static void drawNodeLabel(XmlNode xmlNode, double x, double y, const char *label, const GraphIO::SVGSettings &settings);
 
 	/**
 	 * Draws a single cluster as a rectangle.
@@ -214,28 +407,36 @@ private:
 	 * \param xmlNode the XML-node to print to
 	 * \param c the cluster to be printed
 	 */
-	void drawCluster(pugi::xml_node xmlNode, cluster c);
+	template<class XmlNode>
+	void drawCluster(XmlNode xmlNode, cluster c);
+
+	/**
+	 * Returns the geometry of the end of an edge at one of its nodes.
+	 *
+	 * \param e the edge
+	 * \param v the node at that end
+	 * \param arrow whether an arrow head is drawn at that end
+	 */
+	EdgeEnd edgeEnd(edge e, node v, bool arrow);
 
 	/**
 	 * Determines whether a candidate arrow tip lies inside the rectangle of the node.
 	 *
 	 * \param point the candidate arrow tip
-	 * \param e the edge of the arrow head
-	 * \param v the node the arrow is facing
+	 * \param end the end of the edge at the node the arrow is facing
 	 */
-	bool isCoveredBy(const DPoint &point, edge e, node v);
+	static bool isCoveredBy(const DPoint &point, const EdgeEnd &end);
 
 	/**
-	 * Draws an arrow head at the end of the edge.
+	 * Computes the polygon of an arrow head at the end of the edge.
 	 * Sets the end point of the respective edge segment to the arrow head's tip.
 	 *
-	 * \param xmlNode the XML-node to print to
 	 * \param start the start point of the edge segment the arrow head will be placed on
 	 * \param end the end point of the edge segment the arrow head will be placed on, this will usually be modified
-	 * \param v the node that the arrow is facing
-	 * \param e the edge that the arrow belongs to
+	 * \param v the end of the edge at the node that the arrow is facing
+	 * \return the coordinates of the arrow head's corners
 	 */
-	void drawArrowHead(pugi::xml_node xmlNode, const DPoint &start, DPoint &end, node v, edge e);
+	static std::vector<double> arrowHead(const DPoint &start, DPoint &end, const EdgeEnd &v);
 
 	/**
 	 * Returns the size of the arrow.
@@ -245,13 +446,32 @@ private:
 	 */
 	double getArrowSize(edge e, node v);
 
+	/**
+	 * Returns the size of an arrow between two nodes of the given sizes.
+	 *
+	 * \param strokeWidth the stroke width of the edge
+	 * \param width the width of the node that the arrow is facing
+	 * \param height the height of the node that the arrow is facing
+	 * \param oppositeWidth the width of the node at the other end of the edge
+	 * \param oppositeHeight the height of the node at the other end of the edge
+	 */
+	static double getArrowSize(float strokeWidth, double width, double height, double oppositeWidth, double oppositeHeight);
+
+	/**
+	 * Returns the stroke of an edge.
+	 *
+	 * \param e the edge
+	 */
+	LineStyle lineStyle(edge e);
+
 	/**
 	 * Writes the requested line style to the line's XML-node.
 	 *
 	 * \param line the XML-node depicting the line
-	 * \param e the edge associated with that line
+	 * \param style the stroke of the line
 	 */
-	void appendLineStyle(pugi::xml_node line, edge e);
+	template<class XmlNode>
+	static void appendLineStyle(XmlNode line, const LineStyle &style);
 
 	/**
 	 * Draws a polygon with the respective points.
@@ -260,7 +480,8 @@ private:
 	 * \param points the list of coordinates
 	 * \return The generated XML-node
 	 */
-	pugi::xml_node drawPolygon(pugi::xml_node xmlNode, const std::list<double> points);
+	template<class XmlNode>
+	static XmlNode drawPolygon(XmlNode xmlNode, const std::vector<double> &points);
 };
 
 }
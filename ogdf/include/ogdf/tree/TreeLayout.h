@@ -81,6 +81,12 @@ namespace ogdf {
  *     selection strategies are to take a (unique) source or sink in
  *     the graph, or to use the coordinates and to select the topmost
  *     node for top-to-bottom orientation, etc.
+ *   </tr><tr>
+ *     <td><i>maxThreads</i><td>int<td>System::numberOfProcessors()
+ *     <td>The maximal number of threads used for laying out the trees of
+ *     a forest, which are independent until they are placed side by side.
+ *     A single tree uses them only for the coordinates of its wide levels.
+ *     To achieve sequential behaviour, set maxThreads to 1.
  *   </tr>
  * </table>
  *
@@ -108,6 +114,7 @@ private:
 	bool m_orthogonalLayout;         //!< Option for orthogonal style (yes/no).
 	Orientation m_orientation;       //!< Option for orientation of tree layout.
 	RootSelectionType m_selectRoot;  //!< Option for how to determine the root.
+	unsigned int m_maxThreads;       //!< The maximal number of used threads.
 
 public:
 	//! Creates an instance of tree layout and sets options to default values.
@@ -196,6 +203,16 @@ public:
 	//! Sets the option that determines how the root is selected to \p rootSelection.
 	void rootSelection(RootSelectionType rootSelection) { m_selectRoot = rootSelection; }
 
+	//! Returns the maximal number of used threads.
+	unsigned int maxThreads() const { return m_maxThreads; }
+
+	//! Sets the maximal number of used threads to \p n, at least one.
+	void maxThreads(unsigned int n) {
+#ifndef OGDF_MEMORY_POOL_NTS
+		m_maxThreads = max(1u, n);
+#endif
+	}
+
 
 	/** @}
 	 *  @name Operators
@@ -215,26 +232,30 @@ private:
 	void setRoot(GraphAttributes &AG, Graph &tree, SListPure<edge> &reversedEdges);
 	void undoReverseEdges(GraphAttributes &AG, Graph &tree, SListPure<edge> &reversedEdges);
 
-	// recursive bottom up traversal of the tree for computing
-	// preliminary x-coordinates
-	void firstWalk(TreeStructure &ts, node subtree, bool upDown);
+	// the walks identify nodes by their preorder numbers in ts
+
+	// bottom up traversal of the tree for computing
+	// preliminary x-coordinates, iterative so that deep trees
+	// cannot overflow the call stack
+	void firstWalk(TreeStructure &ts, int subtree);
 
 	// space out the small subtrees on the left hand side of subtree
-	// defaultAncestor is used for all nodes with obsolete m_ancestor
+	// defaultAncestor is used for all nodes with obsolete ancestor
 	void apportion(
 		TreeStructure &ts,
-		node subtree,
-		node &defaultAncestor,
-		bool upDown);
+		int subtree,
+		int &defaultAncestor);
 
-	// recursive top down traversal of the tree for computing final
+	// top down traversal of the tree for computing final
 	// x-coordinates
-	void secondWalkX(TreeStructure &ts, node subtree, double modifierSum);
-	void secondWalkY(TreeStructure &ts, node subtree, double modifierSum);
-
-	// compute y-coordinates and edge shapes
-	void computeYCoordinatesAndEdgeShapes(node root,GraphAttributes &AG);
-	void computeXCoordinatesAndEdgeShapes(node root,GraphAttributes &AG);
+	void secondWalkX(TreeStructure &ts, int subtree, double modifierSum);
+	void secondWalkY(TreeStructure &ts, int subtree, double modifierSum);
+	void secondWalk(TreeStructure &ts, int subtree, double modifierSum);
+
+	// compute y-coordinates and edge shapes level by level,
+	// using up to nThreads threads on wide levels
+	void computeYCoordinatesAndEdgeShapes(TreeStructure &ts, int subtree, unsigned int nThreads);
+	void computeXCoordinatesAndEdgeShapes(TreeStructure &ts, int subtree, unsigned int nThreads);
 
 	void findMinX(GraphAttributes &AG, node root, double &minX);
 	void findMinY(GraphAttributes &AG, node root, double &minY);
@@ -31,6 +31,8 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <limits>
 
 #include <ogdf/fileformats/SvgPrinter.h>
 #include <ogdf/basic/Queue.h>
@@ -44,6 +46,7 @@ GraphIO::SVGSettings::SVGSettings()
 	m_margin = 1;
 	m_curviness = 0;
 	m_bezierInterpolation = false;
+	m_streaming = false;
 	m_fontSize = 10;
 	m_fontColor = "#000000";
 	m_fontFamily = "Arial";
@@ -51,10 +54,493 @@ GraphIO::SVGSettings::SVGSettings()
 	m_height = "";
 }
 
+namespace {
+
+//! Powers of ten from 10^-5 to 10^22, exact from 10^0 on.
+const double powersOfTen[] = {
+	1e-5, 1e-4, 1e-3, 1e-2, 1e-1, 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+	1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/**
+ * Rounds \p a to \p precision significant digits, \p exponent being the exponent of its
+ * leading digit, which is corrected if it is off by one.
+ *
+ * Scaling by an exact power of ten costs one rounding in \p Real, so the result is only
+ * certain if the scaled value is not too close to a tie; returns false otherwise.
+ */
+template<class Real>
+bool roundScaled(double a, int precision, int &exponent, uint64_t &digits)
+{
+	const Real low = static_cast<Real>(powersOfTen[precision - 1 + 5]);
+	const Real high = static_cast<Real>(powersOfTen[precision + 5]);
+	Real scaled = 0;
+
+	for (int tries = 0; tries < 3; tries++) {
+		int shift = precision - 1 - exponent;
+		scaled = shift >= 0
+			? a * static_cast<Real>(powersOfTen[shift + 5])
+			: a / static_cast<Real>(powersOfTen[-shift + 5]);
+
+		if (scaled < low) {
+			exponent--;
+		} else if (scaled >= high) {
+			exponent++;
+		} else {
+			break;
+		}
+	}
+
+	if (!(scaled >= low && scaled < high)) {
+		return false;
+	}
+
+	uint64_t whole = static_cast<uint64_t>(scaled);
+	Real fraction = scaled - static_cast<Real>(whole);
+	// scaled is off by half a unit in the last place at most
+	if (std::fabs(fraction - 0.5) <= scaled * std::numeric_limits<Real>::epsilon()) {
+		return false;
+	}
+
+	digits = whole + (fraction > 0.5 ? 1 : 0);
+	if (digits == static_cast<uint64_t>(high)) {
+		digits /= 10;
+		exponent++;
+	}
+
+	return true;
+}
+
+/**
+ * Writes \p value like snprintf with "%.<precision>g" to \p buf, which holds 32 characters,
+ * and returns the number of characters written.
+ *
+ * Multiples of small powers of two are written out exactly. Other values of the size
+ * found in drawings are scaled to \p precision digits, in long double
+ * beyond 14 digits, and rounded there, which is several times faster than snprintf. Where
+ * the scaled value is too close to a tie between two roundings to tell, or out of range,
+ * snprintf does the work.
+ */
+int formatNumber(char *buf, double value, int precision)
+{
+	if (value == 0) {
+		return std::signbit(value) ? snprintf(buf, 32, "-0") : snprintf(buf, 32, "0");
+	}
+
+	double a = std::fabs(value);
+
+	// keeps the powers of ten to scale by within the exact ones
+	if (!(a >= 1e-5 && a < 1e15) || precision < 1 || precision > 17) {
+		return snprintf(buf, 32, "%.*g", precision, value);
+	}
+
+	// multiples of 1/2^k for small k, as most coordinates are, have k decimals exactly
+	uint64_t fivePower = 1;
+	double scaled = a;
+	for (int decimals = 0; decimals <= 4; decimals++, fivePower *= 5, scaled *= 2) {
+		if (scaled != std::floor(scaled)) {
+			continue;
+		}
+
+		uint64_t exact = static_cast<uint64_t>(scaled) * fivePower;
+		if (exact >= static_cast<uint64_t>(powersOfTen[precision + 5])) {
+			break;
+		}
+
+		char reversed[24];
+		int length = 0;
+		for (int i = 0; i < decimals; i++) {
+			reversed[length++] = static_cast<char>('0' + exact % 10);
+			exact /= 10;
+		}
+		if (decimals > 0) {
+			reversed[length++] = '.';
+		}
+		do {
+			reversed[length++] = static_cast<char>('0' + exact % 10);
+			exact /= 10;
+		} while (exact > 0);
+
+		char *p = buf;
+		if (value < 0) {
+			*p++ = '-';
+		}
+		while (length > 0) {
+			*p++ = reversed[--length];
+		}
+		*p = 0;
+		return static_cast<int>(p - buf);
+	}
+
+	// exponent of the leading digit
+	int exponent = -5;
+	while (exponent < 14 && a >= powersOfTen[exponent + 1 + 5]) {
+		exponent++;
+	}
+
+	uint64_t digits;
+	bool decided = precision <= 14
+		? roundScaled<double>(a, precision, exponent, digits)
+		: roundScaled<long double>(a, precision, exponent, digits);
+	if (!decided) {
+		return snprintf(buf, 32, "%.*g", precision, value);
+	}
+
+	char mantissa[20];
+	for (int i = precision - 1; i >= 0; i--) {
+		mantissa[i] = static_cast<char>('0' + digits % 10);
+		digits /= 10;
+	}
+	int significant = precision;
+	while (significant > 1 && mantissa[significant - 1] == '0') {
+		significant--;
+	}
+
+	char *p = buf;
+	if (value < 0) {
+		*p++ = '-';
+	}
+
+	if (exponent < -4 || exponent >= precision) {
+		*p++ = mantissa[0];
+		if (significant > 1) {
+			*p++ = '.';
+			for (int i = 1; i < significant; i++) {
+				*p++ = mantissa[i];
+			}
+		}
+		*p++ = 'e';
+		*p++ = exponent < 0 ? '-' : '+';
+		int e = exponent < 0 ? -exponent : exponent;
+		if (e >= 100) {
+			*p++ = static_cast<char>('0' + e / 100);
+		}
+		*p++ = static_cast<char>('0' + e / 10 % 10);
+		*p++ = static_cast<char>('0' + e % 10);
+	} else if (exponent >= 0) {
+		for (int i = 0; i <= exponent; i++) {
+			*p++ = mantissa[i];
+		}
+		if (significant > exponent + 1) {
+			*p++ = '.';
+			for (int i = exponent + 1; i < significant; i++) {
+				*p++ = mantissa[i];
+			}
+		}
+	} else {
+		*p++ = '0';
+		*p++ = '.';
+		for (int i = 0; i < -exponent - 1; i++) {
+			*p++ = '0';
+		}
+		for (int i = 0; i < significant; i++) {
+			*p++ = mantissa[i];
+		}
+	}
+
+	*p = 0;
+	return static_cast<int>(p - buf);
+}
+
+/**
+ * Returns the value of a stroke-width attribute, to_string(\p width) followed by "px".
+ */
+std::string pixels(float width)
+{
+	// integral widths, by far the most common ones, without snprintf
+	if (width == std::floor(width) && width >= 0 && width < 1e9f) {
+		return std::to_string(static_cast<long>(width)) + ".000000px";
+	}
+
+	return to_string(width) + "px";
+}
+
+/**
+ * Writes XML in the layout of pugi::xml_document::save() while it is generated.
+ *
+ * Mirrors the parts of the pugi::xml_node interface used by SvgPrinter. Appending a child
+ * to a node closes all elements opened below that node since, so only the chain of open
+ * elements is kept in memory. Attributes can only be appended to the innermost open
+ * element before anything is appended to it.
+ */
+class XmlStreamWriter
+{
+	struct Element {
+		const char *name;
+		bool hasChildren;
+		bool hasText;
+	};
+
+public:
+	class Node;
+
+	//! Proxy writing the value assigned to a freshly appended attribute.
+	class Attribute
+	{
+		XmlStreamWriter &m_writer;
+
+	public:
+		explicit Attribute(XmlStreamWriter &writer) : m_writer(writer) { }
+
+		void operator=(const char *value) {
+			m_writer.writeEscaped(value, true);
+			m_writer.put('"');
+		}
+
+		void operator=(double value) {
+			char buf[32];
+			m_writer.write(buf, formatNumber(buf, value, 17));
+			m_writer.put('"');
+		}
+
+		void operator=(int value) {
+			char buf[16];
+			m_writer.write(buf, snprintf(buf, sizeof(buf), "%d", value));
+			m_writer.put('"');
+		}
+	};
+
+	//! Proxy writing the text content assigned to the innermost element.
+	class Text
+	{
+		XmlStreamWriter &m_writer;
+
+	public:
+		explicit Text(XmlStreamWriter &writer) : m_writer(writer) { }
+
+		void operator=(const char *value) {
+			OGDF_ASSERT(!m_writer.m_open.back().hasChildren);
+			m_writer.put('>');
+			m_writer.writeEscaped(value, false);
+			m_writer.m_open.back().hasChildren = true;
+			m_writer.m_open.back().hasText = true;
+		}
+	};
+
+	class Node
+	{
+		XmlStreamWriter *m_writer;
+		size_t m_depth; //!< number of open elements up to and including this one
+
+	public:
+		Node() : m_writer(nullptr), m_depth(0) { }
+
+		Node(XmlStreamWriter *writer, size_t depth) : m_writer(writer), m_depth(depth) { }
+
+		Node append_child(const char *name) {
+			m_writer->closeAbove(m_depth);
+
+			if (m_depth > 0) {
+				Element &parent = m_writer->m_open.back();
+				if (!parent.hasChildren) {
+					m_writer->put('>');
+					parent.hasChildren = true;
+				}
+				m_writer->newLine(m_depth);
+			}
+
+			m_writer->put('<');
+			m_writer->write(name, strlen(name));
+			m_writer->m_open.push_back({name, false, false});
+
+			return Node(m_writer, m_depth + 1);
+		}
+
+		Attribute append_attribute(const char *name) {
+			OGDF_ASSERT(m_writer->m_open.size() == m_depth);
+			OGDF_ASSERT(!m_writer->m_open.back().hasChildren);
+
+			m_writer->put(' ');
+			m_writer->write(name, strlen(name));
+			m_writer->put('=');
+			m_writer->put('"');
+
+			return Attribute(*m_writer);
+		}
+
+		Text text() {
+			OGDF_ASSERT(m_writer->m_open.size() == m_depth);
+			return Text(*m_writer);
+		}
+	};
+
+	explicit XmlStreamWriter(std::ostream &os) : m_os(os) {
+		m_buffer.reserve(bufferSize);
+		const char declaration[] = "<?xml version=\"1.0\"?>\n";
+		write(declaration, sizeof(declaration) - 1);
+	}
+
+	//! Returns the document node.
+	Node document() {
+		return Node(this, 0);
+	}
+
+	//! Closes all open elements and flushes the output.
+	void finish() {
+		closeAbove(0);
+		put('\n');
+		flush();
+	}
+
+private:
+	static const size_t bufferSize = 1 << 16;
+
+	std::ostream &m_os;
+	std::vector<Element> m_open;
+	std::string m_buffer;
+
+	void flush() {
+		m_os.write(m_buffer.data(), m_buffer.size());
+		m_buffer.clear();
+	}
+
+	void put(char c) {
+		m_buffer.push_back(c);
+	}
+
+	void write(const char *s, size_t length) {
+		if (m_buffer.size() + length > bufferSize) {
+			flush();
+		}
+		m_buffer.append(s, length);
+	}
+
+	void newLine(size_t depth) {
+		put('\n');
+		m_buffer.append(depth, '\t');
+	}
+
+	//! Closes open elements until \p depth are left.
+	void closeAbove(size_t depth) {
+		while (m_open.size() > depth) {
+			const Element &e = m_open.back();
+			if (!e.hasChildren) {
+				write(" />", 3);
+			} else {
+				if (!e.hasText) {
+					newLine(m_open.size() - 1);
+				}
+				put('<');
+				put('/');
+				write(e.name, strlen(e.name));
+				put('>');
+			}
+			m_open.pop_back();
+		}
+	}
+
+	//! Escapes like pugixml: markup characters and control characters other than whitespace.
+	void writeEscaped(const char *s, bool attribute) {
+		const char *run = s; // start of the characters not written yet
+		for (; *s; s++) {
+			unsigned char c = static_cast<unsigned char>(*s);
+			if (c >= 32 && c != '&' && c != '<' && c != '>' && c != '"') {
+				continue;
+			}
+			write(run, s - run);
+			run = s + 1;
+			switch (c) {
+			case '&':
+				write("&amp;", 5);
+				break;
+			case '<':
+				write("&lt;", 4);
+				break;
+			case '>':
+				write("&gt;", 4);
+				break;
+			case '"':
+				if (attribute) {
+					write("&quot;", 6);
+				} else {
+					put('"');
+				}
+				break;
+			default:
+				if (c != '\t' && (attribute || (c != '\r' && c != '\n'))) {
+					char buf[6] = {'&', '#', static_cast<char>(c / 10 + '0'), static_cast<char>(c % 10 + '0'), ';', 0};
+					write(buf, 5);
+				} else {
+					put(*s);
+				}
+			}
+		}
+		write(run, s - run);
+	}
+};
+
+}
+
+/**
+ * Collects the path data and point lists of SvgPrinter.
+ *
+ * Numbers are written like a std::stringstream with default settings writes them.
+ */
+class SvgPrinter::PathStream
+{
+	std::string m_text;
+
+public:
+	PathStream() {
+		// enough for a line or an arrow head without growing
+		m_text.reserve(128);
+	}
+
+	PathStream &operator<<(const char *s) {
+		m_text += s;
+		return *this;
+	}
+
+	PathStream &operator<<(double value) {
+		char buf[32];
+		m_text.append(buf, formatNumber(buf, value, 6));
+		return *this;
+	}
+
+	PathStream &operator<<(int value) {
+		m_text += std::to_string(value);
+		return *this;
+	}
+
+	const std::string &str() const {
+		return m_text;
+	}
+};
+
 bool SvgPrinter::draw(std::ostream &os)
 {
-	pugi::xml_document doc;
-	pugi::xml_node rootNode = writeHeader(doc);
+	if (m_settings.streaming()) {
+		XmlStreamWriter writer(os);
+		drawDocument(writer.document());
+		writer.finish();
+	} else {
+		pugi::xml_document doc;
+		drawDocument<pugi::xml_node>(doc);
+		doc.save(os);
+	}
+
+	return true;
+}
+
+bool SvgPrinter::draw(std::ostream &os, const StraightLineDrawing &drawing, const GraphIO::SVGSettings &settings)
+{
+	if (settings.streaming()) {
+		XmlStreamWriter writer(os);
+		drawDocument(writer.document(), drawing, settings);
+		writer.finish();
+	} else {
+		pugi::xml_document doc;
+		drawDocument<pugi::xml_node>(doc, drawing, settings);
+		doc.save(os);
+	}
+
+	return true;
+}
+
+template<class XmlNode>
+void SvgPrinter::drawDocument(XmlNode doc)
+{
+	XmlNode rootNode = writeHeader(doc);
 
 	if(m_clsAttr) {
 		drawClusters(rootNode);
@@ -62,32 +548,84 @@ bool SvgPrinter::draw(std::ostream &os)
 
 	drawEdges(rootNode);
 	drawNodes(rootNode);
+}
 
-	doc.save(os);
+template<class XmlNode>
+void SvgPrinter::drawDocument(XmlNode doc, const StraightLineDrawing &drawing, const GraphIO::SVGSettings &settings)
+{
+	// bounding box as GraphAttributes::boundingBox() computes it
+	double minX = 0, maxX = 0, minY = 0, maxY = 0;
 
-	return true;
+	if (drawing.numberOfNodes() > 0) {
+		minX = maxX = drawing.x(0);
+		minY = maxY = drawing.y(0);
+	}
+
+	for (int v = 0; v < drawing.numberOfNodes(); v++) {
+		double lw = 0.5 * drawing.strokeWidth(v);
+
+		Math::updateMin(minX, drawing.x(v) - drawing.width(v) / 2 - lw);
+		Math::updateMax(maxX, drawing.x(v) + drawing.width(v) / 2 + lw);
+		Math::updateMin(minY, drawing.y(v) - drawing.height(v) / 2 - lw);
+		Math::updateMax(maxY, drawing.y(v) + drawing.height(v) / 2 + lw);
+	}
+
+	XmlNode rootNode = writeHeader(doc, DRect(minX, minY, maxX, maxY), settings);
+
+	XmlNode edges = rootNode.append_child("g");
+
+	for (int e = 0; e < drawing.numberOfEdges(); e++) {
+		int s = drawing.source(e);
+		int t = drawing.target(e);
+		float strokeWidth = drawing.edgeStrokeWidth(e);
+
+		EdgeEnd source = {DPoint(drawing.x(s), drawing.y(s)), drawing.width(s), drawing.height(s),
+			getArrowSize(strokeWidth, drawing.width(s), drawing.height(s), drawing.width(t), drawing.height(t)), false};
+		EdgeEnd target = {DPoint(drawing.x(t), drawing.y(t)), drawing.width(t), drawing.height(t),
+			getArrowSize(strokeWidth, drawing.width(t), drawing.height(t), drawing.width(s), drawing.height(s)), true};
+
+		DPolyline path;
+		path.pushBack(source.center);
+		path.pushBack(target.center);
+
+		if (!drawEdge(edges, path, source, target, nullptr, {true, StrokeType::Solid, drawing.edgeStrokeColor(e), strokeWidth}, settings)) {
+			GraphIO::logger.lout() << "Could not draw edge since nodes are overlapping: " << e << std::endl;
+		}
+	}
+
+	for (int v = 0; v < drawing.numberOfNodes(); v++) {
+		XmlNode xmlNode = rootNode.append_child("g");
+		XmlNode shape = drawShape(xmlNode, drawing.shape(v), drawing.x(v), drawing.y(v), drawing.width(v), drawing.height(v));
+		appendNodeStyle(shape, drawing.fillColor(v), StrokeType::Solid, drawing.strokeColor(v), drawing.strokeWidth(v));
+		drawNodeLabel(xmlNode, drawing.x(v), drawing.y(v), drawing.label(v).c_str(), settings);
+	}
+}
+
+template<class XmlNode>
+XmlNode SvgPrinter::writeHeader(XmlNode doc)
+{
+	return writeHeader(doc, m_clsAttr ? m_clsAttr->boundingBox() : m_attr.boundingBox(), m_settings);
 }
 
-pugi::xml_node SvgPrinter::writeHeader(pugi::xml_document &doc)
+template<class XmlNode>
+XmlNode SvgPrinter::writeHeader(XmlNode doc, const DRect &box, const GraphIO::SVGSettings &settings)
 {
-	pugi::xml_node rootNode = doc.append_child("svg");
+	XmlNode rootNode = doc.append_child("svg");
 	rootNode.append_attribute("xmlns") = "http://www.w3.org/2000/svg";
 	rootNode.append_attribute("xmlns:xlink") = "http://www.w3.org/1999/xlink";
 	rootNode.append_attribute("xmlns:ev") = "http://www.w3.org/2001/xml-events";
 	rootNode.append_attribute("version") = "1.1";
 	rootNode.append_attribute("baseProfile") = "full";
 
-	if(!m_settings.width().empty()) {
-		rootNode.append_attribute("width") = m_settings.width().c_str();
+	if(!settings.width().empty()) {
+		rootNode.append_attribute("width") = settings.width().c_str();
 	}
 
-	if(!m_settings.height().empty()) {
-		rootNode.append_attribute("height") = m_settings.height().c_str();
+	if(!settings.height().empty()) {
+		rootNode.append_attribute("height") = settings.height().c_str();
 	}
 
-	DRect box = m_clsAttr ? m_clsAttr->boundingBox() : m_attr.boundingBox();
-
-	double margin = m_settings.margin();
+	double margin = settings.margin();
 	std::stringstream is;
 	is << (box.p1().m_x - margin);
 	is << " " << (box.p1().m_y - margin);
@@ -98,7 +636,8 @@ pugi::xml_node SvgPrinter::writeHeader(pugi::xml_document &doc)
 	return rootNode;
 }
 
-void SvgPrinter::writeDashArray(pugi::xml_node xmlNode, StrokeType lineStyle, double lineWidth)
+template<class XmlNode>
+void SvgPrinter::writeDashArray(XmlNode xmlNode, StrokeType lineStyle, double lineWidth)
 {
 	if(lineStyle != StrokeType::None && lineStyle != StrokeType::Solid) {
 		std::stringstream is;
@@ -125,51 +664,71 @@ void SvgPrinter::writeDashArray(pugi::xml_node xmlNode, StrokeType lineStyle, do
 	}
 }
 
-void SvgPrinter::drawNode(pugi::xml_node xmlNode, node v)
+template<class XmlNode>
+void SvgPrinter::drawNode(XmlNode xmlNode, node v)
+{
+	xmlNode = xmlNode.append_child("g");
+	XmlNode shape = drawShape(xmlNode, m_attr.shape(v), m_attr.x(v), m_attr.y(v), m_attr.width(v), m_attr.height(v));
+
+	if (m_attr.has(GraphAttributes::nodeStyle)) {
+		appendNodeStyle(shape, m_attr.fillColor(v), m_attr.strokeType(v), m_attr.strokeColor(v), m_attr.strokeWidth(v));
+	}
+
+	if (m_attr.has(GraphAttributes::nodeLabel)) {
+		double labelX = m_attr.x(v);
+		double labelY = m_attr.y(v);
+
+		if(m_attr.has(GraphAttributes::nodeLabelPosition)) {
+			labelX += m_attr.xLabel(v);
+			labelY += m_attr.yLabel(v);
+		}
+
+		drawNodeLabel(xmlNode, labelX, labelY, m_attr.label(v).c_str(), m_settings);
+	}
+}
+
+template<class XmlNode>
+XmlNode SvgPrinter::drawShape(XmlNode xmlNode, Shape shape, double x, double y, double width, double height)
 {
 #if 1
 	const double
-	  hexagonHalfHeight = 0.43301270189222 * m_attr.height(v),
-	  pentagonHalfWidth = 0.475528258147577 * m_attr.width(v),
-	  pentagonSmallHeight = 0.154508497187474 * m_attr.height(v),
-	  pentagonSmallWidth = 0.293892626146236 * m_attr.width(v),
-	  pentagonHalfHeight = 0.404508497187474 * m_attr.height(v),
-	  octagonHalfWidth = 0.461939766255643 * m_attr.width(v),
-	  octagonSmallWidth = 0.191341716182545 * m_attr.width(v),
-	  octagonHalfHeight  = 0.461939766255643 * m_attr.height(v),
-	  octagonSmallHeight = 0.191341716182545 * m_attr.height(v);
+	  hexagonHalfHeight = 0.43301270189222 * height,
+	  pentagonHalfWidth = 0.475528258147577 * width,
+	  pentagonSmallHeight = 0.154508497187474 * height,
+	  pentagonSmallWidth = 0.293892626146236 * width,
+	  pentagonHalfHeight = 0.404508497187474 * height,
+	  octagonHalfWidth = 0.461939766255643 * width,
+	  octagonSmallWidth = 0.191341716182545 * width,
+	  octagonHalfHeight  = 0.461939766255643 * height,
+	  octagonSmallHeight = 0.191341716182545 * height;
 #endif
-	pugi::xml_node shape;
-	std::stringstream is;
-	double x = m_attr.x(v);
-	double y = m_attr.y(v);
-	xmlNode = xmlNode.append_child("g");
+	XmlNode result;
 
 	// values are precomputed to save expensive sin/cos calls
-	switch (m_attr.shape(v)) {
+	switch (shape) {
 	case Shape::Ellipse:
-		shape = xmlNode.append_child("ellipse");
-		shape.append_attribute("cx") = x;
-		shape.append_attribute("cy") = y;
-		shape.append_attribute("rx") = m_attr.width(v) / 2;
-		shape.append_attribute("ry") = m_attr.height(v) / 2;
+		result = xmlNode.append_child("ellipse");
+		result.append_attribute("cx") = x;
+		result.append_attribute("cy") = y;
+		result.append_attribute("rx") = width / 2;
+		result.append_attribute("ry") = height / 2;
 		break;
 	case Shape::Triangle:
-		shape = drawPolygon(xmlNode, {
-					x, y - m_attr.height(v)/2,
-					x - m_attr.width(v)/2, y + m_attr.height(v)/2,
-					x + m_attr.width(v)/2, y + m_attr.height(v)/2
+		result = drawPolygon(xmlNode, {
+					x, y - height/2,
+					x - width/2, y + height/2,
+					x + width/2, y + height/2
 				});
 		break;
 	case Shape::InvTriangle:
-		shape = drawPolygon(xmlNode, {x, y + m_attr.height(v)/2,
-					x - m_attr.width(v)/2, y - m_attr.height(v)/2,
-					x + m_attr.width(v)/2,y - m_attr.height(v)/2
+		result = drawPolygon(xmlNode, {x, y + height/2,
+					x - width/2, y - height/2,
+					x + width/2,y - height/2
 				});
 		break;
 	case Shape::Pentagon:
-		shape = drawPolygon(xmlNode, {
-					x, y - m_attr.height(v)/2,
+		result = drawPolygon(xmlNode, {
+					x, y - height/2,
 					x + pentagonHalfWidth, y - pentagonSmallHeight,
 					x + pentagonSmallWidth, y + pentagonHalfHeight,
 					x - pentagonSmallWidth, y + pentagonHalfHeight,
@@ -177,17 +736,17 @@ void SvgPrinter::drawNode(pugi::xml_node xmlNode, node v)
 				});
 		break;
 	case Shape::Hexagon:
-		shape = drawPolygon(xmlNode, {
-					x + m_attr.width(v)/4, y + hexagonHalfHeight,
-					x - m_attr.width(v)/4, y + hexagonHalfHeight,
-					x - m_attr.width(v)/2, y,
-					x - m_attr.width(v)/4, y - hexagonHalfHeight,
-					x + m_attr.width(v)/4, y - hexagonHalfHeight,
-					x + m_attr.width(v)/2, y
+		result = drawPolygon(xmlNode, {
+					x + width/4, y + hexagonHalfHeight,
+					x - width/4, y + hexagonHalfHeight,
+					x - width/2, y,
+					x - width/4, y - hexagonHalfHeight,
+					x + width/4, y - hexagonHalfHeight,
+					x + width/2, y
 				});
 		break;
 	case Shape::Octagon:
-		shape = drawPolygon(xmlNode, {
+		result = drawPolygon(xmlNode, {
 					x + octagonHalfWidth, y + octagonSmallHeight,
 					x + octagonSmallWidth, y + octagonHalfHeight,
 					x - octagonSmallWidth, y + octagonHalfHeight,
@@ -199,112 +758,109 @@ void SvgPrinter::drawNode(pugi::xml_node xmlNode, node v)
 				});
 		break;
 	case Shape::Rhomb:
-		shape = drawPolygon(xmlNode, {
-					x + m_attr.width(v)/2, y,
-					x, y + m_attr.height(v)/2,
-					x - m_attr.width(v)/2, y,
-					x, y - m_attr.height(v)/2
+		result = drawPolygon(xmlNode, {
+					x + width/2, y,
+					x, y + height/2,
+					x - width/2, y,
+					x, y - height/2
 				});
 		break;
 	case Shape::Trapeze:
-		shape = drawPolygon(xmlNode, {
-					x - m_attr.width(v)/2, y + m_attr.height(v)/2,
-					x + m_attr.width(v)/2, y + m_attr.height(v)/2,
-					x + m_attr.width(v)/4, y - m_attr.height(v)/2,
-					x - m_attr.width(v)/4, y - m_attr.height(v)/2
+		result = drawPolygon(xmlNode, {
+					x - width/2, y + height/2,
+					x + width/2, y + height/2,
+					x + width/4, y - height/2,
+					x - width/4, y - height/2
 				});
 		break;
 	case Shape::InvTrapeze:
-		shape = drawPolygon(xmlNode, {
-					x - m_attr.width(v)/2, y - m_attr.height(v)/2,
-					x + m_attr.width(v)/2, y - m_attr.height(v)/2,
-					x + m_attr.width(v)/4, y + m_attr.height(v)/2,
-					x - m_attr.width(v)/4, y + m_attr.height(v)/2
+		result = drawPolygon(xmlNode, {
+					x - width/2, y - height/2,
+					x + width/2, y - height/2,
+					x + width/4, y + height/2,
+					x - width/4, y + height/2
 				});
 		break;
 	case Shape::Parallelogram:
-		shape = drawPolygon(xmlNode, {
-					x - m_attr.width(v)/2, y + m_attr.height(v)/2,
-					x + m_attr.width(v)/4, y + m_attr.height(v)/2,
-					x + m_attr.width(v)/2, y - m_attr.height(v)/2,
-					x - m_attr.width(v)/4, y - m_attr.height(v)/2
+		result = drawPolygon(xmlNode, {
+					x - width/2, y + height/2,
+					x + width/4, y + height/2,
+					x + width/2, y - height/2,
+					x - width/4, y - height/2
 				});
 		break;
 	case Shape::InvParallelogram:
-		shape = drawPolygon(xmlNode, {
-					x - m_attr.width(v)/2, y - m_attr.height(v)/2,
-					x + m_attr.width(v)/4, y - m_attr.height(v)/2,
-					x + m_attr.width(v)/2, y + m_attr.height(v)/2,
-					x - m_attr.width(v)/4, y + m_attr.height(v)/2
+		result = drawPolygon(xmlNode, {
+					x - width/2, y - height/2,
+					x + width/4, y - height/2,
+					x + width/2, y + height/2,
+					x - width/4, y + height/2
 				});
 		break;
 	// unsupported shapes are rendered as rectangle
 	default:
-		shape = xmlNode.append_child("rect");
-		shape.append_attribute("x") = x - m_attr.width(v)/2;
-		shape.append_attribute("y") = y - m_attr.height(v)/2;
-		shape.append_attribute("width") = m_attr.width(v);
-		shape.append_attribute("height") = m_attr.height(v);
-
-		if (m_attr.shape(v) == Shape::RoundedRect) {
-			shape.append_attribute("rx") = m_attr.width(v) / 10;
-			shape.append_attribute("ry") = m_attr.height(v) / 10;
+		result = xmlNode.append_child("rect");
+		result.append_attribute("x") = x - width/2;
+		result.append_attribute("y") = y - height/2;
+		result.append_attribute("width") = width;
+		result.append_attribute("height") = height;
+
+		if (shape == Shape::RoundedRect) {
+			result.append_attribute("rx") = width / 10;
+			result.append_attribute("ry") = height / 10;
 		}
 	}
 
-	if (m_attr.has(GraphAttributes::nodeStyle)) {
-		shape.append_attribute("fill") = m_attr.fillColor(v).toString().c_str();
-		shape.append_attribute("stroke-width") = (to_string(m_attr.strokeWidth(v)) + "px").c_str();
+	return result;
+}
 
-		StrokeType lineStyle = m_attr.has(GraphAttributes::nodeStyle) ? m_attr.strokeType(v) : StrokeType::Solid;
+template<class XmlNode>
+void SvgPrinter::appendNodeStyle(XmlNode shape, const Color &fillColor, StrokeType strokeType, const Color &strokeColor, float strokeWidth)
+{
+	shape.append_attribute("fill") = fillColor.toString().c_str();
+	shape.append_attribute("stroke-width") = pixels(strokeWidth).c_str();
 
-		if(lineStyle == StrokeType::None) {
-			shape.append_attribute("stroke") = "none";
-		} else {
-			shape.append_attribute("stroke") = m_attr.strokeColor(v).toString().c_str();
-			writeDashArray(shape, lineStyle, m_attr.strokeWidth(v));
-		}
+	if(strokeType == StrokeType::None) {
+		shape.append_attribute("stroke") = "none";
+	} else {
+		shape.append_attribute("stroke") = strokeColor.toString().c_str();
+		writeDashArray(shape, strokeType, strokeWidth);
 	}
+}
 
-	if (m_attr.has(GraphAttributes::nodeLabel)) {
-		pugi::xml_node label = xmlNode.append_child("text");
-		label.append_attribute("x") = m_attr.x(v);
-		label.append_attribute("y") = m_attr.y(v);
-		label.append_attribute("text-anchor") = "middle";
-		label.append_attribute("dominant-baseline") = "middle";
-		label.append_attribute("font-family") = m_settings.fontFamily().c_str();
-		label.append_attribute("font-size") = m_settings.fontSize();
-		label.append_attribute("fill") = m_settings.fontColor().c_str();
-		label.text() = m_attr.label(v).c_str();
-
-		if(m_attr.has(GraphAttributes::nodeLabelPosition)) {
-			label.attribute("x") = m_attr.x(v) + m_attr.xLabel(v);
-			label.attribute("y") = m_attr.y(v) + m_attr.yLabel(v);
-		}
-	}
+template<class XmlNode>
+void SvgPrinter::drawNodeLabel(XmlNode xmlNode, double x, double y, const char *label, const GraphIO::SVGSettings &settings)
+{
+	XmlNode text = xmlNode.append_child("text");
+	text.append_attribute("x") = x;
+	text.append_attribute("y") = y;
+	text.append_attribute("text-anchor") = "middle";
+	text.append_attribute("dominant-baseline") = "middle";
+	text.append_attribute("font-family") = settings.fontFamily().c_str();
+	text.append_attribute("font-size") = settings.fontSize();
+	text.append_attribute("fill") = settings.fontColor().c_str();
+	text.text() = label;
 }
 
-void SvgPrinter::drawCluster(pugi::xml_node xmlNode, cluster c)
+template<class XmlNode>
+void SvgPrinter::drawCluster(XmlNode xmlNode, cluster c)
 {
 	OGDF_ASSERT(m_clsAttr);
 
-	pugi::xml_node cluster;
-
-	if (c == m_clsAttr->constClusterGraph().rootCluster()) {
-		cluster = xmlNode;
-	} else {
-		pugi::xml_node clusterXmlNode = xmlNode.append_child("rect");
+	if (c != m_clsAttr->constClusterGraph().rootCluster()) {
+		XmlNode clusterXmlNode = xmlNode.append_child("rect");
 		clusterXmlNode.append_attribute("x") = m_clsAttr->x(c);
 		clusterXmlNode.append_attribute("y") = m_clsAttr->y(c);
 		clusterXmlNode.append_attribute("width") = m_clsAttr->width(c);
 		clusterXmlNode.append_attribute("height") = m_clsAttr->height(c);
 		clusterXmlNode.append_attribute("fill") = m_clsAttr->fillPattern(c) == FillPattern::None ? "none" : m_clsAttr->fillColor(c).toString().c_str();
 		clusterXmlNode.append_attribute("stroke") = m_clsAttr->strokeType(c) == StrokeType::None ? "none" : m_clsAttr->strokeColor(c).toString().c_str();
-		clusterXmlNode.append_attribute("stroke-width") = (to_string(m_clsAttr->strokeWidth(c)) + "px").c_str();
+		clusterXmlNode.append_attribute("stroke-width") = pixels(m_clsAttr->strokeWidth(c)).c_str();
 	}
 }
 
-void SvgPrinter::drawNodes(pugi::xml_node xmlNode)
+template<class XmlNode>
+void SvgPrinter::drawNodes(XmlNode xmlNode)
 {
 	List<node> nodes;
 	m_attr.constGraph().allNodes(nodes);
@@ -318,7 +874,8 @@ void SvgPrinter::drawNodes(pugi::xml_node xmlNode)
 	}
 }
 
-void SvgPrinter::drawClusters(pugi::xml_node xmlNode)
+template<class XmlNode>
+void SvgPrinter::drawClusters(XmlNode xmlNode)
 {
 	OGDF_ASSERT(m_clsAttr);
 
@@ -335,7 +892,8 @@ void SvgPrinter::drawClusters(pugi::xml_node xmlNode)
 	}
 }
 
-void SvgPrinter::drawEdges(pugi::xml_node xmlNode)
+template<class XmlNode>
+void SvgPrinter::drawEdges(XmlNode xmlNode)
 {
 	if (m_attr.has(GraphAttributes::edgeGraphics)) {
 		xmlNode = xmlNode.append_child("g");
@@ -346,26 +904,34 @@ void SvgPrinter::drawEdges(pugi::xml_node xmlNode)
 	}
 }
 
-void SvgPrinter::appendLineStyle(pugi::xml_node line, edge e) {
+SvgPrinter::LineStyle SvgPrinter::lineStyle(edge e) {
+	if (m_attr.has(GraphAttributes::edgeStyle)) {
+		return {true, m_attr.strokeType(e), m_attr.strokeColor(e), m_attr.strokeWidth(e)};
+	} else {
+		return {false, StrokeType::Solid, Color(Color::Name::Black), 1.0f};
+	}
+}
 
-	StrokeType lineStyle = m_attr.has(GraphAttributes::edgeStyle) ? m_attr.strokeType(e) : StrokeType::Solid;
+template<class XmlNode>
+void SvgPrinter::appendLineStyle(XmlNode line, const LineStyle &style) {
 
-	if(lineStyle != StrokeType::None) {
-		if (m_attr.has(GraphAttributes::edgeStyle)) {
-			line.append_attribute("stroke") = m_attr.strokeColor(e).toString().c_str();
-			line.append_attribute("stroke-width") = (to_string(m_attr.strokeWidth(e)) + "px").c_str();
-			writeDashArray(line, lineStyle, m_attr.strokeWidth(e));
+	if(style.type != StrokeType::None) {
+		if (style.styled) {
+			line.append_attribute("stroke") = style.color.toString().c_str();
+			line.append_attribute("stroke-width") = pixels(style.width).c_str();
+			writeDashArray(line, style.type, style.width);
 		} else {
 			line.append_attribute("stroke") = "#000000";
 		}
 	}
 }
 
-pugi::xml_node SvgPrinter::drawPolygon(pugi::xml_node xmlNode, const std::list<double> points) {
-	pugi::xml_node result = xmlNode.append_child("polygon");
+template<class XmlNode>
+XmlNode SvgPrinter::drawPolygon(XmlNode xmlNode, const std::vector<double> &points) {
+	XmlNode result = xmlNode.append_child("polygon");
 	OGDF_ASSERT(points.size() % 2 == 0);
 
-	std::stringstream is;
+	PathStream is;
 	bool writeSpace = false;
 
 	for(double p : points) {
@@ -381,24 +947,32 @@ double SvgPrinter::getArrowSize(edge e, node v) {
 	double result = 0;
 
 	if(m_attr.has(GraphAttributes::edgeArrow) || m_attr.directed()) {
-		const double minSize = (m_attr.has(GraphAttributes::edgeStyle) ? m_attr.strokeWidth(e) : 1) * 3;
 		node w = e->opposite(v);
-		result = std::max(minSize, (m_attr.width(v) + m_attr.height(v) + m_attr.width(w) + m_attr.height(w)) / 16.0);
+		result = getArrowSize(m_attr.has(GraphAttributes::edgeStyle) ? m_attr.strokeWidth(e) : 1,
+		                      m_attr.width(v), m_attr.height(v), m_attr.width(w), m_attr.height(w));
 	}
 
 	return result;
 }
 
-bool SvgPrinter::isCoveredBy(const DPoint &point, edge e, node v) {
-	double arrowSize = getArrowSize(e, v);
+double SvgPrinter::getArrowSize(float strokeWidth, double width, double height, double oppositeWidth, double oppositeHeight) {
+	const double minSize = strokeWidth * 3;
+	return std::max(minSize, (width + height + oppositeWidth + oppositeHeight) / 16.0);
+}
 
-	return point.m_x >= m_attr.x(v) - m_attr.width(v)/2 - arrowSize
-	    && point.m_x <= m_attr.x(v) + m_attr.width(v)/2 + arrowSize
-	    && point.m_y >= m_attr.y(v) - m_attr.height(v)/2 - arrowSize
-	    && point.m_y <= m_attr.y(v) + m_attr.height(v)/2 + arrowSize;
+SvgPrinter::EdgeEnd SvgPrinter::edgeEnd(edge e, node v, bool arrow) {
+	return {DPoint(m_attr.x(v), m_attr.y(v)), m_attr.width(v), m_attr.height(v), getArrowSize(e, v), arrow};
 }
 
-void SvgPrinter::drawEdge(pugi::xml_node xmlNode, edge e) {
+bool SvgPrinter::isCoveredBy(const DPoint &point, const EdgeEnd &end) {
+	return point.m_x >= end.center.m_x - end.width/2 - end.arrowSize
+	    && point.m_x <= end.center.m_x + end.width/2 + end.arrowSize
+	    && point.m_y >= end.center.m_y - end.height/2 - end.arrowSize
+	    && point.m_y <= end.center.m_y + end.height/2 + end.arrowSize;
+}
+
+template<class XmlNode>
+void SvgPrinter::drawEdge(XmlNode xmlNode, edge e) {
 	// draw arrows if G is directed or if arrow types are defined for the edge
 	bool drawSourceArrow = false;
 	bool drawTargetArrow = false;
@@ -423,19 +997,7 @@ void SvgPrinter::drawEdge(pugi::xml_node xmlNode, edge e) {
 		}
 	}
 
-	xmlNode = xmlNode.append_child("g");
-	bool drawLabel = m_attr.has(GraphAttributes::edgeLabel) && !m_attr.label(e).empty();
-	pugi::xml_node label;
-
-	if(drawLabel) {
-		label = xmlNode.append_child("text");
-		label.append_attribute("text-anchor") = "middle";
-		label.append_attribute("dominant-baseline") = "middle";
-		label.append_attribute("font-family") = m_settings.fontFamily().c_str();
-		label.append_attribute("font-size") = m_settings.fontSize();
-		label.append_attribute("fill") = m_settings.fontColor().c_str();
-		label.text() = m_attr.label(e).c_str();
-	}
+	bool hasLabel = m_attr.has(GraphAttributes::edgeLabel) && !m_attr.label(e).empty();
 
 	DPolyline path = m_attr.bends(e);
 	node s = e->source();
@@ -443,36 +1005,49 @@ void SvgPrinter::drawEdge(pugi::xml_node xmlNode, edge e) {
 	path.pushFront(DPoint(m_attr.x(s), m_attr.y(s)));
 	path.pushBack(DPoint(m_attr.x(t), m_attr.y(t)));
 
+	if (!drawEdge(xmlNode, path, edgeEnd(e, s, drawSourceArrow), edgeEnd(e, t, drawTargetArrow),
+	              hasLabel ? m_attr.label(e).c_str() : nullptr, lineStyle(e), m_settings)) {
+		GraphIO::logger.lout() << "Could not draw edge since nodes are overlapping: " << e << std::endl;
+	}
+}
+
+template<class XmlNode>
+bool SvgPrinter::drawEdge(XmlNode xmlNode, const DPolyline &path, const EdgeEnd &source, const EdgeEnd &target,
+                          const char *label, const LineStyle &style, const GraphIO::SVGSettings &settings) {
+	bool drawLabel = label != nullptr;
+	DPoint labelPosition;
+
 	bool drawSegment = false;
 	bool finished = false;
 
 	List<DPoint> points;
+	List<std::vector<double>> arrowHeads;
 
+	// the geometry is computed first so that every element is complete once it is appended
 	for(ListConstIterator<DPoint> it = path.begin(); it.succ().valid() && !finished; it++) {
 		DPoint p1 = *it;
 		DPoint p2 = *(it.succ());
 
 		// leaving segment at source node ?
-		if(isCoveredBy(p1, e, s) && !isCoveredBy(p2, e, s)) {
-			if(!drawSegment && drawSourceArrow) {
-				drawArrowHead(xmlNode, p2, p1, s, e);
+		if(isCoveredBy(p1, source) && !isCoveredBy(p2, source)) {
+			if(!drawSegment && source.arrow) {
+				arrowHeads.emplaceBack(arrowHead(p2, p1, source));
 			}
 
 			drawSegment = true;
 		}
 
 		// entering segment at target node ?
-		if(!isCoveredBy(p1, e, t) && isCoveredBy(p2, e, t)) {
+		if(!isCoveredBy(p1, target) && isCoveredBy(p2, target)) {
 			finished = true;
 
-			if(drawTargetArrow) {
-				drawArrowHead(xmlNode, p1, p2, t, e);
+			if(target.arrow) {
+				arrowHeads.emplaceBack(arrowHead(p1, p2, target));
 			}
 		}
 
 		if(drawSegment && drawLabel) {
-			label.append_attribute("x") = (p1.m_x + p2.m_x) / 2;
-			label.append_attribute("y") = (p1.m_y + p2.m_y) / 2;
+			labelPosition = DPoint((p1.m_x + p2.m_x) / 2, (p1.m_y + p2.m_y) / 2);
 
 			drawLabel = false;
 		}
@@ -486,24 +1061,48 @@ void SvgPrinter::drawEdge(pugi::xml_node xmlNode, edge e) {
 		}
 	}
 
+	xmlNode = xmlNode.append_child("g");
+
+	if(label != nullptr) {
+		XmlNode text = xmlNode.append_child("text");
+		text.append_attribute("text-anchor") = "middle";
+		text.append_attribute("dominant-baseline") = "middle";
+		text.append_attribute("font-family") = settings.fontFamily().c_str();
+		text.append_attribute("font-size") = settings.fontSize();
+		text.append_attribute("fill") = settings.fontColor().c_str();
+
+		// a label is only placed once the edge leaves its source
+		if(!drawLabel) {
+			text.append_attribute("x") = labelPosition.m_x;
+			text.append_attribute("y") = labelPosition.m_y;
+		}
+
+		text.text() = label;
+	}
+
+	for(const std::vector<double> &arrow : arrowHeads) {
+		appendLineStyle(drawPolygon(xmlNode, arrow), style);
+	}
+
 	if(points.size() < 2) {
-		GraphIO::logger.lout() << "Could not draw edge since nodes are overlapping: " << e << std::endl;
-	} else {
-		drawCurve(xmlNode, e, points);
+		return false;
 	}
+
+	drawCurve(xmlNode, points, style, settings);
+	return true;
 }
 
-void SvgPrinter::drawLine(std::stringstream &ss, const DPoint &p1, const DPoint &p2) {
+void SvgPrinter::drawLine(PathStream &ss, const DPoint &p1, const DPoint &p2) {
 	ss << " M" << p1.m_x << "," << p1.m_y << " L" << p2.m_x << "," << p2.m_y;
 }
 
 
-void SvgPrinter::drawBezier(std::stringstream &ss, const DPoint &p1, const DPoint &p2, const DPoint &c1, const DPoint &c2) {
+void SvgPrinter::drawBezier(PathStream &ss, const DPoint &p1, const DPoint &p2, const DPoint &c1, const DPoint &c2) {
 	ss << " M" << p1.m_x << "," << p1.m_y << " C" << c1.m_x << "," << c1.m_y << "  " << c2.m_x << "," << c2.m_y << " " << p2.m_x << "," << p2.m_y;
 }
 
-void SvgPrinter::drawBezierPath(std::stringstream &ss, List<DPoint> &points) {
-	const double c = m_settings.curviness();
+void SvgPrinter::drawBezierPath(PathStream &ss, List<DPoint> &points, double curviness) {
+	const double c = curviness;
 	DPoint cLast = 0.5 * (points.front() + *points.get(1));
 
 	while(points.size() >= 3) {
@@ -527,8 +1126,8 @@ void SvgPrinter::drawBezierPath(std::stringstream &ss, List<DPoint> &points) {
 	drawBezier(ss, p1, p2, cLast, c1);
 }
 
-void SvgPrinter::drawRoundPath(std::stringstream &ss, List<DPoint> &points) {
-	const double c = m_settings.curviness();
+void SvgPrinter::drawRoundPath(PathStream &ss, List<DPoint> &points, double curviness) {
+	const double c = curviness;
 
 	DPoint p1 = points.front();
 	DPoint p2 = *points.get(1);
@@ -567,18 +1166,19 @@ void SvgPrinter::drawRoundPath(std::stringstream &ss, List<DPoint> &points) {
 	drawLine(ss, p2, .5 * ((p1 + p2) + (1-c) * (p1-p2)));
 }
 
-void SvgPrinter::drawLines(std::stringstream &ss, List<DPoint> &points) {
+void SvgPrinter::drawLines(PathStream &ss, List<DPoint> &points) {
 	while(points.size() > 1) {
 		DPoint p = points.popFrontRet();
 		drawLine(ss, p, points.front());
 	}
 }
 
-pugi::xml_node SvgPrinter::drawCurve(pugi::xml_node xmlNode, edge e, List<DPoint> &points) {
+template<class XmlNode>
+XmlNode SvgPrinter::drawCurve(XmlNode xmlNode, List<DPoint> &points, const LineStyle &style, const GraphIO::SVGSettings &settings) {
 	OGDF_ASSERT(points.size() >= 2);
 
-	pugi::xml_node line = xmlNode.append_child("path");
-	std::stringstream ss;
+	XmlNode line = xmlNode.append_child("path");
+	PathStream ss;
 
 	if(points.size() == 2) {
 		const DPoint p1 = points.popFrontRet();
@@ -586,53 +1186,51 @@ pugi::xml_node SvgPrinter::drawCurve(pugi::xml_node xmlNode, edge e, List<DPoint
 
 		drawLine(ss, p1, p2);
 	} else {
-		if(m_settings.curviness() == 0) {
+		if(settings.curviness() == 0) {
 			drawLines(ss, points);
-		} else if(m_settings.bezierInterpolation()) {
-			drawBezierPath(ss, points);
+		} else if(settings.bezierInterpolation()) {
+			drawBezierPath(ss, points, settings.curviness());
 		} else {
-			drawRoundPath(ss, points);
+			drawRoundPath(ss, points, settings.curviness());
 		}
 	}
 
 	line.append_attribute("fill") = "none";
 	line.append_attribute("d") = ss.str().c_str();
-	appendLineStyle(line, e);
+	appendLineStyle(line, style);
 
 	return line;
 }
 
-void SvgPrinter::drawArrowHead(pugi::xml_node xmlNode, const DPoint &start, DPoint &end, node v, edge e)
+std::vector<double> SvgPrinter::arrowHead(const DPoint &start, DPoint &end, const EdgeEnd &v)
 {
 	const double dx = end.m_x - start.m_x;
 	const double dy = end.m_y - start.m_y;
-	const double size = getArrowSize(e, v);
-
-	pugi::xml_node arrowHead;
+	const double size = v.arrowSize;
 
 	if(dx == 0) {
 		int sign = dy > 0 ? 1 : -1;
-		double y = m_attr.y(v) - m_attr.height(v)/2 * sign;
+		double y = v.center.m_y - v.height/2 * sign;
 		end.m_y = y - sign * size;
 
-		arrowHead = drawPolygon(xmlNode, {
+		return {
 				end.m_x, y,
 				end.m_x - size/4, y - size*sign,
 				end.m_x + size/4, y - size*sign
-		});
+		};
 	} else {
 		// identify the position of the tip
 
 		double slope = dy / dx;
 		int sign = dx > 0 ? 1 : -1;
 
-		double x = m_attr.x(v) - m_attr.width(v)/2 * sign;
+		double x = v.center.m_x - v.width/2 * sign;
 		double delta = x - start.m_x;
 		double y = start.m_y + delta*slope;
 
-		if(!isCoveredBy(DPoint(x,y), e, v)) {
+		if(!isCoveredBy(DPoint(x,y), v)) {
 			sign = dy > 0 ? 1 : -1;
-			y = m_attr.y(v) - m_attr.height(v)/2 * sign;
+			y = v.center.m_y - v.height/2 * sign;
 			delta = y - start.m_y;
 			x = start.m_x + delta/slope;
 		}
@@ -657,8 +1255,6 @@ void SvgPrinter::drawArrowHead(pugi::xml_node xmlNode, const DPoint &start, DPoi
 		double x3 = mx + size/4 * dy2;
 		double y3 = my - size/4 * dx2;
 
-		arrowHead = drawPolygon(xmlNode, {end.m_x, end.m_y, x2, y2, x3, y3});
+		return {end.m_x, end.m_y, x2, y2, x3, y3};
 	}
-
-	appendLineStyle(arrowHead, e);
 }
@@ -34,6 +34,8 @@
 #include <ogdf/tree/TreeLayout.h>
 #include <ogdf/basic/AdjEntryArray.h>
 #include <ogdf/basic/simple_graph_alg.h>
+#include <ogdf/basic/Thread.h>
+#include <atomic>
 
 
 namespace ogdf {
@@ -47,7 +49,13 @@ TreeLayout::TreeLayout()
 	 m_orthogonalLayout(false),
 	 m_orientation(Orientation::topToBottom),
 	 m_selectRoot(RootSelectionType::Source)
-{ }
+{
+#ifdef OGDF_MEMORY_POOL_NTS
+	m_maxThreads = 1u;
+#else
+	m_maxThreads = max(1u, Thread::hardware_concurrency());
+#endif
+}
 
 
 TreeLayout::TreeLayout(const TreeLayout &tl)
@@ -57,7 +65,8 @@ TreeLayout::TreeLayout(const TreeLayout &tl)
 	 m_treeDistance(tl.m_treeDistance),
 	 m_orthogonalLayout(tl.m_orthogonalLayout),
 	 m_orientation(tl.m_orientation),
-	 m_selectRoot(tl.m_selectRoot)
+	 m_selectRoot(tl.m_selectRoot),
+	 m_maxThreads(tl.m_maxThreads)
 { }
 
 
@@ -70,155 +79,181 @@ TreeLayout &TreeLayout::operator=(const TreeLayout &tl)
 	m_orthogonalLayout = tl.m_orthogonalLayout;
 	m_orientation      = tl.m_orientation;
 	m_selectRoot       = tl.m_selectRoot;
+	m_maxThreads       = tl.m_maxThreads;
 	return *this;
 }
 
 
 struct TreeLayout::TreeStructure {
 
-	GraphAttributes &m_ga;
-	NodeArray<int> m_number;         //!< Consecutive numbers for children.
-
-	NodeArray<node> m_parent;        //!< Parent node, 0 if root.
-	NodeArray<node> m_leftSibling;   //!< Left sibling, 0 if none.
-	NodeArray<node> m_firstChild;    //!< Leftmost child, 0 if leaf.
-	NodeArray<node> m_lastChild;	 //!< Rightmost child, 0 if leaf.
-	NodeArray<node> m_thread;        //!< Thread, 0 if none.
-	NodeArray<node> m_ancestor;      //!< Actual highest ancestor.
+	//! The fields of a node the walks work on, 64 bytes in all.
+	/**
+	 * Nodes are numbered in preorder, tree by tree, so the first child of
+	 * node i is always i+1 and the subtree of i spans the next size numbers.
+	 * The left contours are thereby scanned in order of memory, and the
+	 * second walk is a single sweep over the numbers of a tree.
+	 */
+	struct Record {
+		int parent = -1;        //!< Parent node, -1 if root.
+		int leftSibling = -1;   //!< Left sibling, -1 if none.
+		int rightSibling = -1;  //!< Right sibling, -1 if none.
+		int lastChild = -1;     //!< Rightmost child, -1 if leaf.
+		int thread = -1;        //!< Thread, -1 if none.
+		int ancestor = -1;      //!< Actual highest ancestor.
+		int number = 0;         //!< Consecutive numbers for children.
+		int size = 1;           //!< Number of nodes in the subtree.
+
+		double preliminary = 0; //!< Preliminary x-coordinates.
+		double modifier = 0;    //!< Modifier of x-coordinates.
+		double change = 0;      //!< Change of shift applied to subtrees.
+		double shift = 0;       //!< Shift applied to subtrees.
+	};
 
-	NodeArray<double> m_preliminary; //!< Preliminary x-coordinates.
-	NodeArray<double> m_modifier;    //!< Modifier of x-coordinates.
-	NodeArray<double> m_change;      //!< Change of shift applied to subtrees.
-	NodeArray<double> m_shift;       //!< Shift applied to subtrees.
+	GraphAttributes &m_ga;
+	NodeArray<int> m_index;   //!< Preorder number of every node.
+	Array<node> m_node;       //!< Node of every number.
+	Array<Record> m_record;   //!< Record of every number.
+	Array<double> m_breadth;  //!< Width (height for left-right layouts) of every number.
+	Array<edge> m_inEdge;     //!< Edge from the parent of every number, nullptr for roots.
 
 
-	// initialize all node arrays and
+	// number the nodes, initialize the records and
 	// compute the tree structure from the adjacency lists
 	//
 	// returns the root nodes in roots
-	TreeStructure(const Graph &tree, GraphAttributes &GA, List<node> &roots) :
+	TreeStructure(const Graph &tree, GraphAttributes &GA, bool upDown, List<node> &roots) :
 		m_ga(GA),
-		m_number(tree, 0),
-		m_parent(tree, nullptr),
-		m_leftSibling(tree, nullptr),
-		m_firstChild(tree, nullptr),
-		m_lastChild(tree, nullptr),
-		m_thread(tree, nullptr),
-		m_ancestor(tree, nullptr),
-		m_preliminary(tree, 0),
-		m_modifier(tree, 0),
-		m_change(tree, 0),
-		m_shift(tree, 0)
+		m_index(tree, -1),
+		m_node(tree.numberOfNodes()),
+		m_record(tree.numberOfNodes()),
+		m_breadth(tree.numberOfNodes()),
+		m_inEdge(tree.numberOfNodes())
 	{
-		// compute the tree structure
-
 		// find the roots
-		//node root = 0;
 		for (node v : tree.nodes) {
 			if (v->indeg() == 0)
 				roots.pushBack(v);
 		}
 
-		int childCounter;
-		for (node v : tree.nodes) {
-
-			// determine
-			// - the parent node of v
-			// - the leftmost and rightmost child of v
-			// - the numbers of the children of v
-			// - the left siblings of the children of v
-			// and initialize the actual ancestor of v
-
-			m_ancestor[v] = v;
-			if (isLeaf(v)) {
-				if (v->indeg() == 0) { // is v a root
-					m_parent[v] = nullptr;
-					m_leftSibling[v] = nullptr;
-				}
-				else {
-					m_firstChild[v] = m_lastChild[v] = nullptr;
-					m_parent[v] = v->firstAdj()->theEdge()->source();
+		// number the nodes in preorder; the stack holds the nodes to be
+		// numbered together with the number of their parent and the edge
+		// leading to them
+		struct Entry { node v; int parent; edge e; };
+		ArrayBuffer<Entry> S;
+		int next = 0;
+		for (node root : roots) {
+			S.push(Entry{root, -1, nullptr});
+			while (!S.empty()) {
+				Entry top = S.popRet();
+				node v = top.v;
+				int i = next++;
+				m_index[v] = i;
+				m_node[i] = v;
+				m_inEdge[i] = top.e;
+				m_breadth[i] = upDown ? GA.width(v) : GA.height(v);
+				m_record[i].parent = top.parent;
+				m_record[i].ancestor = i;
+
+				// the children of v follow its leaving edge in the adjacency list,
+				// for a root they start with the first entry; they are pushed in
+				// reverse so that the leftmost child is numbered right after v
+				if (v->outdeg() > 0) {
+					adjEntry stop = v->firstAdj();
+					if (v->indeg() != 0) {
+						while (stop->theEdge()->source() == v)
+							stop = stop->cyclicSucc();
+					}
+					adjEntry adj = stop;
+					do {
+						adj = adj->cyclicPred();
+						if (adj->theEdge()->source() == v)
+							S.push(Entry{adj->twinNode(), i, adj->theEdge()});
+					} while (adj != stop);
 				}
 			}
-			else {
-
-				// traverse the adjacency list of v
-				adjEntry first;    // first leaving edge
-				adjEntry stop;     // successor of last leaving edge
-				first = v->firstAdj();
-				if (v->indeg() == 0) { // is v a root
-					stop = first;
-					m_parent[v] = nullptr;
-					m_leftSibling[v] = nullptr;
-				}
-				else {
-
-					// search for first leaving edge
-					while (first->theEdge()->source() == v)
-						first = first->cyclicSucc();
-					m_parent[v] = first->theEdge()->source();
-					stop = first;
-					first = first->cyclicSucc();
-				}
+		}
 
-				// traverse the children of v
-				m_firstChild[v] = first->theEdge()->target();
-				m_number[m_firstChild[v]] = childCounter = 0;
-				m_leftSibling[m_firstChild[v]] = nullptr;
-				adjEntry previous = first;
-				while (first->cyclicSucc() != stop) {
-					first = first->cyclicSucc();
-					m_number[first->theEdge()->target()] = ++childCounter;
-					m_leftSibling[first->theEdge()->target()]
-						= previous->theEdge()->target();
-					previous = first;
-				}
-				m_lastChild[v] = first->theEdge()->target();
+		// link the children of every node, which are numbered from left to right
+		for (int i = 0; i < next; ++i) {
+			Record &r = m_record[i];
+			if (r.parent < 0)
+				continue;
+			Record &parent = m_record[r.parent];
+			if (parent.lastChild >= 0) {
+				r.leftSibling = parent.lastChild;
+				r.number = m_record[parent.lastChild].number + 1;
+				m_record[parent.lastChild].rightSibling = i;
 			}
+			parent.lastChild = i;
+		}
+
+		// sum up the subtree sizes, children come after their parents
+		for (int i = next - 1; i >= 0; --i) {
+			if (m_record[i].parent >= 0)
+				m_record[m_record[i].parent].size += m_record[i].size;
 		}
 	}
 
-	// returns whether node v is a leaf
-	bool isLeaf(node v) const
+	// returns whether the node numbered i is a leaf
+	bool isLeaf(int i) const
 	{
-		OGDF_ASSERT(v != nullptr);
-
-		// node v is a leaf if and only if no edge leaves v
-		return v->outdeg() == 0;
+		return m_record[i].lastChild < 0;
 	}
 
-	// returns the successor of node v on the left contour
-	// returns 0 if there is none
-	node nextOnLeftContour(node v) const
+	// returns the leftmost child of i, -1 if i is a leaf
+	int firstChild(int i) const
 	{
-		OGDF_ASSERT(v != nullptr);
-		OGDF_ASSERT(v->graphOf() == m_firstChild.graphOf());
-		OGDF_ASSERT(v->graphOf() == m_thread.graphOf());
+		return isLeaf(i) ? -1 : i + 1;
+	}
 
-		// if v has children, the successor of v on the left contour
+	// returns the successor of i on the left contour
+	// returns -1 if there is none
+	int nextOnLeftContour(int i) const
+	{
+		// if i has children, the successor of i on the left contour
 		// is its leftmost child,
-		// otherwise, the successor is the thread of v (may be 0)
-		if (m_firstChild[v] != nullptr)
-			return m_firstChild[v];
+		// otherwise, the successor is the thread of i (may be -1)
+		if (!isLeaf(i))
+			return i + 1;
 		else
-			return m_thread[v];
+			return m_record[i].thread;
 	}
 
-	// returns the successor of node v on the right contour
-	// returns 0 if there is none
-	node nextOnRightContour(node v) const
+	// returns the successor of i on the right contour
+	// returns -1 if there is none
+	int nextOnRightContour(int i) const
 	{
-		OGDF_ASSERT(v != nullptr);
-		OGDF_ASSERT(v->graphOf() == m_lastChild.graphOf());
-		OGDF_ASSERT(v->graphOf() == m_thread.graphOf());
-
-		// if v has children, the successor of v on the right contour
+		// if i has children, the successor of i on the right contour
 		// is its rightmost child,
-		// otherwise, the successor is the thread of v (may be 0)
-		if (m_lastChild[v] != nullptr)
-			return m_lastChild[v];
+		// otherwise, the successor is the thread of i (may be -1)
+		if (!isLeaf(i))
+			return m_record[i].lastChild;
 		else
-			return m_thread[v];
+			return m_record[i].thread;
+	}
+
+	// lists the nodes of the subtree level by level, from left to right on
+	// each level; level k consists of order[levelBegin[k]], ...,
+	// order[levelBegin[k+1]-1], and the last entry of levelBegin is the
+	// size of the subtree
+	void levels(int subtree, Array<int> &order, ArrayBuffer<int> &levelBegin) const
+	{
+		order.init(m_record[subtree].size);
+		levelBegin.clear();
+
+		int end = 0;
+		order[end++] = subtree;
+		int begin = 0;
+		while (begin < end) {
+			levelBegin.push(begin);
+			int levelEnd = end;
+			for (int k = begin; k < levelEnd; ++k) {
+				for (int w = firstChild(order[k]); w >= 0; w = m_record[w].rightSibling)
+					order[end++] = w;
+			}
+			begin = levelEnd;
+		}
+		levelBegin.push(end);
 	}
 
 };
@@ -383,6 +418,31 @@ void TreeLayout::callSortByPositions(GraphAttributes &AG, Graph &tree)
 }
 
 
+// the least number of nodes worth handing to a thread of its own
+static const int minNodesPerThread = 1024;
+
+
+// calls work(i) for i = 0, ..., n-1 on nThreads threads, the calling one included
+template<class Work>
+static void forEachInParallel(int n, unsigned int nThreads, Work work)
+{
+	std::atomic<int> next(0);
+	auto worker = [&] {
+		for (int i = next++; i < n; i = next++)
+			work(i);
+	};
+
+	Array<Thread> thread(nThreads-1);
+	for(unsigned int i = 0; i < nThreads-1; ++i)
+		thread[i] = Thread(worker);
+
+	worker();
+
+	for(unsigned int i = 0; i < nThreads-1; ++i)
+		thread[i].join();
+}
+
+
 void TreeLayout::call(GraphAttributes &AG)
 {
 	const Graph &tree = AG.constGraph();
@@ -396,87 +456,106 @@ void TreeLayout::call(GraphAttributes &AG)
 	OGDF_ASSERT(m_levelDistance > 0);
 
 	// compute the tree structure
-	List<node> roots;
-	TreeStructure ts(tree, AG, roots);
-
-	if(m_orientation == Orientation::topToBottom || m_orientation == Orientation::bottomToTop)
-	{
-		double minX = 0, maxX = 0;
-		for(ListConstIterator<node> it = roots.begin(); it.valid(); ++it)
-		{
-			node root = *it;
+	bool upDown = m_orientation == Orientation::topToBottom || m_orientation == Orientation::bottomToTop;
 
+	List<node> roots;
+	TreeStructure ts(tree, AG, upDown, roots);
+
+	Array<node> root(roots.size());
+	int numberOfTrees = 0;
+	for(node r : roots)
+		root[numberOfTrees++] = r;
+
+	// The trees of a forest do not touch each other's nodes and edges, so
+	// they are laid out concurrently, each with its root at 0. Threads only
+	// pay off for forests that are large enough. A single tree instead uses
+	// the threads for the wide levels of its level by level pass.
+	unsigned int nThreads = min(m_maxThreads,
+		(unsigned int) min(numberOfTrees, max(1, tree.numberOfNodes() / minNodesPerThread)));
+	unsigned int levelThreads = numberOfTrees > 1 ? 1 : min(m_maxThreads,
+		(unsigned int) max(1, tree.numberOfNodes() / minNodesPerThread));
+
+	// the extent of every tree in the direction the trees are lined up
+	Array<double> minPos(numberOfTrees), maxPos(numberOfTrees);
+
+	forEachInParallel(numberOfTrees, nThreads, [&](int i) {
+		node r = root[i];
+		int ri = ts.m_index[r];
+		minPos[i] = std::numeric_limits<double>::max();
+		maxPos[i] = std::numeric_limits<double>::lowest();
+		firstWalk(ts, ri);
+		if(upDown) {
 			// compute x-coordinates
-			firstWalk(ts, root, true);
-			secondWalkX(ts, root, -ts.m_preliminary[root]);
+			secondWalkX(ts, ri, -ts.m_record[ri].preliminary);
 
 			// compute y-coordinates
-			computeYCoordinatesAndEdgeShapes(root,AG);
+			computeYCoordinatesAndEdgeShapes(ts, ri, levelThreads);
 
-			if(it != roots.begin())
-			{
-				findMinX(AG,root,minX);
+			if(numberOfTrees > 1) {
+				findMinX(AG,r,minPos[i]);
+				findMaxX(AG,r,maxPos[i]);
+			}
+		} else {
+			// compute y-coordinates
+			secondWalkY(ts, ri, -ts.m_record[ri].preliminary);
 
-				double shift = maxX + m_treeDistance - minX;
+			// compute x-coordinates
+			computeXCoordinatesAndEdgeShapes(ts, ri, levelThreads);
 
-				shiftTreeX(AG,root,shift);
+			if(numberOfTrees > 1) {
+				findMinY(AG,r,minPos[i]);
+				findMaxY(AG,r,maxPos[i]);
 			}
-
-			findMaxX(AG,root,maxX);
 		}
-
-		// The computed layout draws a tree downwards. If we want to draw the
-		// tree upwards, we simply invert all y-coordinates.
-		if(m_orientation == Orientation::bottomToTop)
-		{
-			for(node v : tree.nodes)
-				AG.y(v) = -AG.y(v);
-
-			for(edge e : tree.edges) {
-				for(DPoint &p: AG.bends(e))
-					p.m_y = -p.m_y;
+	});
+
+	// Line the trees up from left to right (or bottom to top). The shift of
+	// a tree depends on the extents of all trees before it, one prefix pass
+	// over the extents computes them all.
+	if(numberOfTrees > 1) {
+		Array<double> shift(numberOfTrees);
+		double minPosSoFar = 0, maxPosSoFar = 0;
+		for(int i = 0; i < numberOfTrees; ++i) {
+			shift[i] = 0;
+			if(i > 0) {
+				minPosSoFar = min(minPosSoFar, minPos[i]);
+				shift[i] = maxPosSoFar + m_treeDistance - minPosSoFar;
 			}
+			maxPosSoFar = max(maxPosSoFar, maxPos[i] + shift[i]);
 		}
 
-	} else {
-		ListConstIterator<node> it;
-		double minY = 0, maxY = 0;
-		for(it = roots.begin(); it.valid(); ++it)
-		{
-			node root = *it;
-
-			// compute y-coordinates
-			firstWalk(ts, root, false);
-			secondWalkY(ts, root, -ts.m_preliminary[root]);
-
-			// compute y-coordinates
-			computeXCoordinatesAndEdgeShapes(root,AG);
-
-			if(it != roots.begin())
-			{
-				findMinY(AG,root,minY);
-
-				double shift = maxY + m_treeDistance - minY;
+		forEachInParallel(numberOfTrees - 1, nThreads, [&](int i) {
+			if(upDown)
+				shiftTreeX(AG,root[i+1],shift[i+1]);
+			else
+				shiftTreeY(AG,root[i+1],shift[i+1]);
+		});
+	}
 
-				shiftTreeY(AG,root,shift);
-			}
+	// The computed layout draws a tree downwards. If we want to draw the
+	// tree upwards, we simply invert all y-coordinates.
+	if(m_orientation == Orientation::bottomToTop)
+	{
+		for(node v : tree.nodes)
+			AG.y(v) = -AG.y(v);
 
-			findMaxY(AG,root,maxY);
+		for(edge e : tree.edges) {
+			for(DPoint &p: AG.bends(e))
+				p.m_y = -p.m_y;
 		}
+	}
 
-		// The computed layout draws a tree upwards. If we want to draw the
-		// tree downwards, we simply invert all y-coordinates.
-		if(m_orientation == Orientation::rightToLeft)
-		{
-			for(node v : tree.nodes)
-				AG.x(v) = -AG.x(v);
+	// The computed layout draws a tree upwards. If we want to draw the
+	// tree downwards, we simply invert all y-coordinates.
+	if(m_orientation == Orientation::rightToLeft)
+	{
+		for(node v : tree.nodes)
+			AG.x(v) = -AG.x(v);
 
-			for(edge e : tree.edges) {
-				for(DPoint &p: AG.bends(e))
-					p.m_x = -p.m_x;
-			}
+		for(edge e : tree.edges) {
+			for(DPoint &p: AG.bends(e))
+				p.m_x = -p.m_x;
 		}
-
 	}
 }
 
@@ -624,102 +703,87 @@ void TreeLayout::findMaxY(GraphAttributes &AG, node root, double &maxY)
 }
 
 
-void TreeLayout::firstWalk(TreeStructure &ts, node subtree, bool upDown)
+void TreeLayout::firstWalk(TreeStructure &ts, int subtree)
 {
-	OGDF_ASSERT(subtree != nullptr);
-	OGDF_ASSERT(subtree->graphOf() == ts.m_leftSibling.graphOf());
-	OGDF_ASSERT(subtree->graphOf() == ts.m_preliminary.graphOf());
-	OGDF_ASSERT(subtree->graphOf() == ts.m_firstChild.graphOf());
-	OGDF_ASSERT(subtree->graphOf() == ts.m_lastChild.graphOf());
-	OGDF_ASSERT(subtree->graphOf() == ts.m_modifier.graphOf());
-	OGDF_ASSERT(subtree->graphOf() == ts.m_change.graphOf());
-	OGDF_ASSERT(subtree->graphOf() == ts.m_shift.graphOf());
-
-	// compute a preliminary x-coordinate for subtree
-	if(ts.isLeaf(subtree)) {
-
-		// place subtree close to the left sibling
-		node leftSibling = ts.m_leftSibling[subtree];
-		if(leftSibling != nullptr) {
-			if(upDown) {
-				ts.m_preliminary[subtree] = ts.m_preliminary[leftSibling]
-					+ (ts.m_ga.width(subtree) + ts.m_ga.width(leftSibling)) / 2
-					+ m_siblingDistance;
-			} else {
-				ts.m_preliminary[subtree] = ts.m_preliminary[leftSibling]
-					+ (ts.m_ga.height(subtree) + ts.m_ga.height(leftSibling)) / 2
-					+ m_siblingDistance;
-			}
-		}
-		else ts.m_preliminary[subtree] = 0;
-	}
-	else {
-		node defaultAncestor = ts.m_firstChild[subtree];
-
-		// collect the children of subtree
-		List<node> children;
-		node v = ts.m_lastChild[subtree];
-		do {
-			children.pushFront(v);
-			v = ts.m_leftSibling[v];
-		} while(v != nullptr);
-
-		ListIterator<node> it;
-
-		// apply firstwalk and apportion to the children
-		for (it = children.begin(); it.valid(); it = it.succ()) {
-			firstWalk(ts, *it, upDown);
-			apportion(ts, *it, defaultAncestor, upDown);
+	OGDF_ASSERT(subtree >= 0);
+	OGDF_ASSERT(subtree < ts.m_record.size());
+
+	// Post-order traversal along the child, sibling and parent links.
+	// Every node is placed once all of its children are, and apportioned
+	// right after that, before its right sibling is visited. The only
+	// storage is the default ancestor of each inner node on the current
+	// path, kept on a stack that grows with the depth of the tree.
+	ArrayBuffer<int> defaultAncestor;
+
+	int v = subtree;
+	for (;;) {
+		// descend to the leftmost leaf below v
+		while (!ts.isLeaf(v)) {
+			defaultAncestor.push(v + 1);
+			v = v + 1;
 		}
 
-		// shift the small subtrees
-		double shift = 0;
-		double change = 0;
-		children.reverse();
-		for(it = children.begin(); it.valid(); it = it.succ()) {
-			ts.m_preliminary[*it] += shift;
-			ts.m_modifier[*it] += shift;
-			change += ts.m_change[*it];
-			shift += ts.m_shift[*it] + change;
-		}
+		for (;;) {
+			TreeStructure::Record &rv = ts.m_record[v];
+
+			// compute a preliminary x-coordinate for v
+			double midpoint = 0;
+			if (!ts.isLeaf(v)) {
+				defaultAncestor.pop();
+
+				// shift the small subtrees
+				double shift = 0;
+				double change = 0;
+				for (int w = rv.lastChild; w >= 0; w = ts.m_record[w].leftSibling) {
+					TreeStructure::Record &rw = ts.m_record[w];
+					rw.preliminary += shift;
+					rw.modifier += shift;
+					change += rw.change;
+					shift += rw.shift + change;
+				}
 
-		// place the parent node
-		double midpoint = (ts.m_preliminary[children.front()] + ts.m_preliminary[children.back()]) / 2;
-		node leftSibling = ts.m_leftSibling[subtree];
-		if(leftSibling != nullptr) {
-			if(upDown) {
-				ts.m_preliminary[subtree] = ts.m_preliminary[leftSibling]
-					+ (ts.m_ga.width(subtree) + ts.m_ga.width(leftSibling)) / 2
-					+ m_siblingDistance;
-			} else {
-				ts.m_preliminary[subtree] = ts.m_preliminary[leftSibling]
-					+ (ts.m_ga.height(subtree) + ts.m_ga.height(leftSibling)) / 2
+				// place the parent node
+				midpoint = (ts.m_record[v + 1].preliminary + ts.m_record[rv.lastChild].preliminary) / 2;
+			}
+
+			// place v close to the left sibling
+			int leftSibling = rv.leftSibling;
+			if(leftSibling >= 0) {
+				rv.preliminary = ts.m_record[leftSibling].preliminary
+					+ (ts.m_breadth[v] + ts.m_breadth[leftSibling]) / 2
 					+ m_siblingDistance;
+				if (!ts.isLeaf(v))
+					rv.modifier = rv.preliminary - midpoint;
+			}
+			else rv.preliminary = midpoint;
+
+			if (v == subtree)
+				return;
+
+			apportion(ts, v, defaultAncestor.top());
+
+			// continue with the right sibling, or the parent after the last child
+			if (rv.rightSibling >= 0) {
+				v = rv.rightSibling;
+				break;
 			}
-			ts.m_modifier[subtree] =
-				ts.m_preliminary[subtree] - midpoint;
+			v = rv.parent;
 		}
-		else ts.m_preliminary[subtree] = midpoint;
 	}
 }
 
 void TreeLayout::apportion(
 	TreeStructure &ts,
-	node subtree,
-	node &defaultAncestor,
-	bool upDown)
+	int subtree,
+	int &defaultAncestor)
 {
-	OGDF_ASSERT(subtree != nullptr);
-	OGDF_ASSERT(subtree->graphOf() == defaultAncestor->graphOf());
-	OGDF_ASSERT(subtree->graphOf() == ts.m_leftSibling.graphOf());
-	OGDF_ASSERT(subtree->graphOf() == ts.m_firstChild.graphOf());
-	OGDF_ASSERT(subtree->graphOf() == ts.m_modifier.graphOf());
-	OGDF_ASSERT(subtree->graphOf() == ts.m_ancestor.graphOf());
-	OGDF_ASSERT(subtree->graphOf() == ts.m_change.graphOf());
-	OGDF_ASSERT(subtree->graphOf() == ts.m_shift.graphOf());
-	OGDF_ASSERT(subtree->graphOf() == ts.m_thread.graphOf());
-
-	if(ts.m_leftSibling[subtree] == nullptr) return;
+	OGDF_ASSERT(subtree >= 0);
+	OGDF_ASSERT(defaultAncestor >= 0);
+
+	TreeStructure::Record *record = ts.m_record.begin();
+	const double *breadth = ts.m_breadth.begin();
+
+	if(record[subtree].leftSibling < 0) return;
 
 	// check distance to the left of the subtree
 	// and traverse left/right inside/outside contour
@@ -731,26 +795,26 @@ void TreeLayout::apportion(
 
 	double moveDistance;
 	int numberOfSubtrees;
-	node leftAncestor,rightAncestor;
+	int leftAncestor,rightAncestor;
 
 	// start the traversal at the actual level
-	node leftContourOut  = ts.m_firstChild[ts.m_parent[subtree]];
-	node leftContourIn   = ts.m_leftSibling[subtree];
-	node rightContourIn  = subtree;
-	node rightContourOut = subtree;
+	int leftContourOut  = ts.firstChild(record[subtree].parent);
+	int leftContourIn   = record[subtree].leftSibling;
+	int rightContourIn  = subtree;
+	int rightContourOut = subtree;
 	bool stop = false;
 	do {
 
 		// add modifiers
-		leftModSumOut  += ts.m_modifier[leftContourOut];
-		leftModSumIn   += ts.m_modifier[leftContourIn];
-		rightModSumIn  += ts.m_modifier[rightContourIn];
-		rightModSumOut += ts.m_modifier[rightContourOut];
+		leftModSumOut  += record[leftContourOut].modifier;
+		leftModSumIn   += record[leftContourIn].modifier;
+		rightModSumIn  += record[rightContourIn].modifier;
+		rightModSumOut += record[rightContourOut].modifier;
 
 		// actualize ancestor for right contour
-		ts.m_ancestor[rightContourOut] = subtree;
+		record[rightContourOut].ancestor = subtree;
 
-		if(ts.nextOnLeftContour(leftContourOut) != nullptr && ts.nextOnRightContour(rightContourOut) != nullptr)
+		if(ts.nextOnLeftContour(leftContourOut) >= 0 && ts.nextOnRightContour(rightContourOut) >= 0)
 		{
 			// continue traversal
 			leftContourOut  = ts.nextOnLeftContour(leftContourOut);
@@ -759,38 +823,31 @@ void TreeLayout::apportion(
 			rightContourOut = ts.nextOnRightContour(rightContourOut);
 
 			// check if subtree has to be moved
-			if(upDown) {
-				moveDistance = ts.m_preliminary[leftContourIn] + leftModSumIn
-					+ (ts.m_ga.width(leftContourIn) + ts.m_ga.width(rightContourIn)) / 2
-					+ m_subtreeDistance
-					- ts.m_preliminary[rightContourIn] - rightModSumIn;
-			} else {
-				moveDistance = ts.m_preliminary[leftContourIn] + leftModSumIn
-					+ (ts.m_ga.height(leftContourIn) + ts.m_ga.height(rightContourIn)) / 2
-					+ m_subtreeDistance
-					- ts.m_preliminary[rightContourIn] - rightModSumIn;
-			}
+			moveDistance = record[leftContourIn].preliminary + leftModSumIn
+				+ (breadth[leftContourIn] + breadth[rightContourIn]) / 2
+				+ m_subtreeDistance
+				- record[rightContourIn].preliminary - rightModSumIn;
 			if(moveDistance > 0) {
 
 				// compute highest different ancestors of leftContourIn
 				// and rightContourIn
-				if(ts.m_parent[ts.m_ancestor[leftContourIn]] == ts.m_parent[subtree])
-					leftAncestor = ts.m_ancestor[leftContourIn];
+				if(record[record[leftContourIn].ancestor].parent == record[subtree].parent)
+					leftAncestor = record[leftContourIn].ancestor;
 				else leftAncestor = defaultAncestor;
 				rightAncestor = subtree;
 
 				// compute the number of small subtrees in between (plus 1)
 				numberOfSubtrees =
-					ts.m_number[rightAncestor] - ts.m_number[leftAncestor];
+					record[rightAncestor].number - record[leftAncestor].number;
 
 				// compute the shifts and changes of shift
-				ts.m_change[rightAncestor] -= moveDistance / numberOfSubtrees;
-				ts.m_shift[rightAncestor] += moveDistance;
-				ts.m_change[leftAncestor] += moveDistance / numberOfSubtrees;
+				record[rightAncestor].change -= moveDistance / numberOfSubtrees;
+				record[rightAncestor].shift += moveDistance;
+				record[leftAncestor].change += moveDistance / numberOfSubtrees;
 
 				// move subtree to the right by moveDistance
-				ts.m_preliminary[rightAncestor] += moveDistance;
-				ts.m_modifier[rightAncestor] += moveDistance;
+				record[rightAncestor].preliminary += moveDistance;
+				record[rightAncestor].modifier += moveDistance;
 				rightModSumIn += moveDistance;
 				rightModSumOut += moveDistance;
 			}
@@ -799,18 +856,18 @@ void TreeLayout::apportion(
 	} while(!stop);
 
 	// adjust threads
-	if(ts.nextOnRightContour(rightContourOut) == nullptr && ts.nextOnRightContour(leftContourIn) != nullptr)
+	if(ts.nextOnRightContour(rightContourOut) < 0 && ts.nextOnRightContour(leftContourIn) >= 0)
 	{
 		// right subtree smaller than left subforest
-		ts.m_thread[rightContourOut] = ts.nextOnRightContour(leftContourIn);
-		ts.m_modifier[rightContourOut] += leftModSumIn - rightModSumOut;
+		record[rightContourOut].thread = ts.nextOnRightContour(leftContourIn);
+		record[rightContourOut].modifier += leftModSumIn - rightModSumOut;
 	}
 
-	if(ts.nextOnLeftContour(leftContourOut) == nullptr && ts.nextOnLeftContour(rightContourIn) != nullptr)
+	if(ts.nextOnLeftContour(leftContourOut) < 0 && ts.nextOnLeftContour(rightContourIn) >= 0)
 	{
 		// left subforest smaller than right subtree
-		ts.m_thread[leftContourOut] = ts.nextOnLeftContour(rightContourIn);
-		ts.m_modifier[leftContourOut] += rightModSumIn - leftModSumOut;
+		record[leftContourOut].thread = ts.nextOnLeftContour(rightContourIn);
+		record[leftContourOut].modifier += rightModSumIn - leftModSumOut;
 		defaultAncestor = subtree;
 	}
 }
@@ -818,147 +875,220 @@ void TreeLayout::apportion(
 
 void TreeLayout::secondWalkX(
 	TreeStructure &ts,
-	node subtree,
+	int subtree,
 	double modifierSum)
 {
-	OGDF_ASSERT(subtree != nullptr);
-	OGDF_ASSERT(subtree->graphOf() == ts.m_preliminary.graphOf());
-	OGDF_ASSERT(subtree->graphOf() == ts.m_modifier.graphOf());
+	OGDF_ASSERT(subtree >= 0);
 
 	// compute final x-coordinates for the subtree
-	// by recursively aggregating modifiers
-	ts.m_ga.x(subtree) = ts.m_preliminary[subtree] + modifierSum;
-	modifierSum += ts.m_modifier[subtree];
-	for(adjEntry adj : subtree->adjEntries) {
-		edge e = adj->theEdge();
-		if (e->target() != subtree)
-			secondWalkX(ts, e->target(), modifierSum);
-	}
+	// by aggregating modifiers top down
+	secondWalk(ts, subtree, modifierSum);
+	int end = subtree + ts.m_record[subtree].size;
+	for(int i = subtree; i < end; ++i)
+		ts.m_ga.x(ts.m_node[i]) = ts.m_record[i].preliminary;
 }
 
 
 void TreeLayout::secondWalkY(
 	TreeStructure &ts,
-	node subtree,
+	int subtree,
 	double modifierSum)
 {
-	OGDF_ASSERT(subtree != nullptr);
-	OGDF_ASSERT(subtree->graphOf() == ts.m_preliminary.graphOf());
-	OGDF_ASSERT(subtree->graphOf() == ts.m_modifier.graphOf());
+	OGDF_ASSERT(subtree >= 0);
 
 	// compute final y-coordinates for the subtree
-	// by recursively aggregating modifiers
-	ts.m_ga.y(subtree) = ts.m_preliminary[subtree] + modifierSum;
-	modifierSum += ts.m_modifier[subtree];
-	for(adjEntry adj : subtree->adjEntries) {
-		node t = adj->theEdge()->target();
-		if (t != subtree)
-			secondWalkY(ts, t, modifierSum);
+	// by aggregating modifiers top down
+	secondWalk(ts, subtree, modifierSum);
+	int end = subtree + ts.m_record[subtree].size;
+	for(int i = subtree; i < end; ++i)
+		ts.m_ga.y(ts.m_node[i]) = ts.m_record[i].preliminary;
+}
+
+
+void TreeLayout::secondWalk(
+	TreeStructure &ts,
+	int subtree,
+	double modifierSum)
+{
+	// Parents are numbered before their children, so one sweep over the
+	// subtree sees the modifier sum of the ancestors of every node complete.
+	// The sum is kept in the shift field, which the first walk has used up,
+	// and the final coordinate replaces the preliminary one.
+	TreeStructure::Record *record = ts.m_record.begin();
+	int end = subtree + record[subtree].size;
+	record[subtree].shift = modifierSum;
+	for(int i = subtree; i < end; ++i) {
+		TreeStructure::Record &r = record[i];
+		if(i != subtree)
+			r.shift = record[r.parent].shift + record[r.parent].modifier;
+		r.preliminary += r.shift;
 	}
 }
 
 
-void TreeLayout::computeYCoordinatesAndEdgeShapes(node root, GraphAttributes &AG)
+void TreeLayout::computeYCoordinatesAndEdgeShapes(
+	TreeStructure &ts,
+	int subtree,
+	unsigned int nThreads)
 {
-	OGDF_ASSERT(root != nullptr);
+	OGDF_ASSERT(subtree >= 0);
 
-	// compute y-coordinates and edge shapes
-	List<node> oldLevel;   // the nodes of the old level
-	List<node> newLevel;   // the nodes of the new level
-	ListIterator<node> it;
-	double yCoordinate;    // the y-coordinate for the new level
-	double edgeCoordinate; // the y-coordinate for edge bends
-	double newHeight;      // the maximal node height on the new level
+	GraphAttributes &AG = ts.m_ga;
+	const TreeStructure::Record *record = ts.m_record.begin();
 
 	// traverse the tree level by level
-	newLevel.pushBack(root);
-	AG.y(root) = yCoordinate = 0;
-	newHeight = AG.height(root);
-	while(!newLevel.empty()) {
+	Array<int> order;           // the nodes of the subtree level by level
+	ArrayBuffer<int> levelBegin; // where the levels start in order
+	ts.levels(subtree, order, levelBegin);
+
+	double yCoordinate = 0;     // the y-coordinate for the new level
+	double newHeight = AG.height(ts.m_node[subtree]); // the maximal node height on the new level
+	AG.y(ts.m_node[subtree]) = yCoordinate;
+
+	Array<double> chunkHeight(nThreads); // the maximal node height of every chunk
+	for(int k = 1; k + 1 < levelBegin.size(); ++k) {
 		double oldHeight = newHeight; // the maximal node height on the old level
-		newHeight = 0;
-		oldLevel.conc(newLevel);
-		while(!oldLevel.empty()) {
-			node v = oldLevel.popFrontRet();
-			for(adjEntry adj : v->adjEntries) {
-				edge e = adj->theEdge();
-				if(e->target() != v) {
-					node w = adj->theEdge()->target();
-					newLevel.pushBack(w);
-
-					// compute the shape of edge e
-					DPolyline &edgeBends = AG.bends(e);
+		int begin = levelBegin[k];
+		int end = levelBegin[k+1];
+
+		// the y-coordinate for edge bends into the new level
+		double edgeCoordinate = yCoordinate + (oldHeight + m_levelDistance) / 2;
+
+		// Wide levels are split into chunks handled by separate threads.
+		// Every chunk computes the shapes of the edges into its nodes and
+		// the maximal height of its nodes.
+		int nChunks = min(nThreads, (unsigned int) max(1, (end - begin) / minNodesPerThread));
+		int chunkSize = (end - begin + nChunks - 1) / nChunks;
+
+		auto shapeChunk = [&](int c) {
+			double height = 0;
+			int chunkEnd = min(end, begin + (c+1) * chunkSize);
+			for(int k2 = begin + c * chunkSize; k2 < chunkEnd; ++k2) {
+				int w = order[k2];
+
+				// compute the shape of the edge from the parent; bends are
+				// left alone, unless they have to be set or removed
+				DPolyline &edgeBends = AG.bends(ts.m_inEdge[w]);
+				if(m_orthogonalLayout) {
+					edgeBends.clear();
+					edgeBends.pushBack(DPoint(record[record[w].parent].preliminary, edgeCoordinate));
+					edgeBends.pushBack(DPoint(record[w].preliminary, edgeCoordinate));
+				} else if(!edgeBends.empty())
 					edgeBends.clear();
-					if(m_orthogonalLayout) {
-						edgeCoordinate =
-							yCoordinate + (oldHeight + m_levelDistance) / 2;
-						edgeBends.pushBack(DPoint(AG.x(v),edgeCoordinate));
-						edgeBends.pushBack(DPoint(AG.x(w),edgeCoordinate));
-					}
 
-					// compute the maximal node height on the new level
-					if(AG.height(e->target()) > newHeight)
-						newHeight = AG.height(e->target());
-				}
+				if(AG.height(ts.m_node[w]) > height)
+					height = AG.height(ts.m_node[w]);
 			}
+			chunkHeight[c] = height;
+		};
+
+		if(nChunks > 1)
+			forEachInParallel(nChunks, nChunks, shapeChunk);
+		else
+			shapeChunk(0);
+
+		// compute the maximal node height on the new level
+		newHeight = 0;
+		for(int c = 0; c < nChunks; ++c) {
+			if(chunkHeight[c] > newHeight)
+				newHeight = chunkHeight[c];
 		}
 
 		// assign y-coordinate to the nodes of the new level
 		yCoordinate += (oldHeight + newHeight) / 2 + m_levelDistance;
-		for(it = newLevel.begin(); it.valid(); it = it.succ())
-			AG.y(*it) = yCoordinate;
+		if(nChunks > 1) {
+			forEachInParallel(nChunks, nChunks, [&](int c) {
+				int chunkEnd = min(end, begin + (c+1) * chunkSize);
+				for(int k2 = begin + c * chunkSize; k2 < chunkEnd; ++k2)
+					AG.y(ts.m_node[order[k2]]) = yCoordinate;
+			});
+		} else {
+			for(int k2 = begin; k2 < end; ++k2)
+				AG.y(ts.m_node[order[k2]]) = yCoordinate;
+		}
 	}
 }
 
-void TreeLayout::computeXCoordinatesAndEdgeShapes(node root, GraphAttributes &AG)
+void TreeLayout::computeXCoordinatesAndEdgeShapes(
+	TreeStructure &ts,
+	int subtree,
+	unsigned int nThreads)
 {
-	OGDF_ASSERT(root != nullptr);
+	OGDF_ASSERT(subtree >= 0);
 
-	// compute y-coordinates and edge shapes
-	List<node> oldLevel;   // the nodes of the old level
-	List<node> newLevel;   // the nodes of the new level
-	ListIterator<node> it;
-	double xCoordinate;    // the x-coordinate for the new level
-	double edgeCoordinate; // the x-coordinate for edge bends
-	double newWidth;       // the maximal node width on the new level
+	GraphAttributes &AG = ts.m_ga;
+	const TreeStructure::Record *record = ts.m_record.begin();
 
 	// traverse the tree level by level
-	newLevel.pushBack(root);
-	AG.x(root) = xCoordinate = 0;
-	newWidth = AG.width(root);
-	while(!newLevel.empty()) {
+	Array<int> order;           // the nodes of the subtree level by level
+	ArrayBuffer<int> levelBegin; // where the levels start in order
+	ts.levels(subtree, order, levelBegin);
+
+	double xCoordinate = 0;     // the x-coordinate for the new level
+	double newWidth = AG.width(ts.m_node[subtree]); // the maximal node width on the new level
+	AG.x(ts.m_node[subtree]) = xCoordinate;
+
+	Array<double> chunkWidth(nThreads); // the maximal node width of every chunk
+	for(int k = 1; k + 1 < levelBegin.size(); ++k) {
 		double oldWidth = newWidth; // the maximal node width on the old level
-		newWidth = 0;
-		oldLevel.conc(newLevel);
-		while(!oldLevel.empty()) {
-			node v = oldLevel.popFrontRet();
-			for(adjEntry adj : v->adjEntries) {
-				edge e = adj->theEdge();
-				if(e->target() != v) {
-					node w = e->target();
-					newLevel.pushBack(w);
-
-					// compute the shape of edge e
-					DPolyline &edgeBends = AG.bends(e);
+		int begin = levelBegin[k];
+		int end = levelBegin[k+1];
+
+		// the x-coordinate for edge bends into the new level
+		double edgeCoordinate = xCoordinate + (oldWidth + m_levelDistance) / 2;
+
+		// Wide levels are split into chunks handled by separate threads.
+		// Every chunk computes the shapes of the edges into its nodes and
+		// the maximal width of its nodes.
+		int nChunks = min(nThreads, (unsigned int) max(1, (end - begin) / minNodesPerThread));
+		int chunkSize = (end - begin + nChunks - 1) / nChunks;
+
+		auto shapeChunk = [&](int c) {
+			double width = 0;
+			int chunkEnd = min(end, begin + (c+1) * chunkSize);
+			for(int k2 = begin + c * chunkSize; k2 < chunkEnd; ++k2) {
+				int w = order[k2];
+
+				// compute the shape of the edge from the parent; bends are
+				// left alone, unless they have to be set or removed
+				DPolyline &edgeBends = AG.bends(ts.m_inEdge[w]);
+				if(m_orthogonalLayout) {
+					edgeBends.clear();
+					edgeBends.pushBack(DPoint(edgeCoordinate, record[record[w].parent].preliminary));
+					edgeBends.pushBack(DPoint(edgeCoordinate, record[w].preliminary));
+				} else if(!edgeBends.empty())
 					edgeBends.clear();
-					if(m_orthogonalLayout) {
-						edgeCoordinate =
-							xCoordinate + (oldWidth + m_levelDistance) / 2;
-						edgeBends.pushBack(DPoint(edgeCoordinate,AG.y(v)));
-						edgeBends.pushBack(DPoint(edgeCoordinate,AG.y(w)));
-					}
 
-					// compute the maximal node width on the new level
-					if(AG.width(e->target()) > newWidth)
-						newWidth = AG.width(e->target());
-				}
+				if(AG.width(ts.m_node[w]) > width)
+					width = AG.width(ts.m_node[w]);
 			}
+			chunkWidth[c] = width;
+		};
+
+		if(nChunks > 1)
+			forEachInParallel(nChunks, nChunks, shapeChunk);
+		else
+			shapeChunk(0);
+
+		// compute the maximal node width on the new level
+		newWidth = 0;
+		for(int c = 0; c < nChunks; ++c) {
+			if(chunkWidth[c] > newWidth)
+				newWidth = chunkWidth[c];
 		}
 
 		// assign x-coordinate to the nodes of the new level
 		xCoordinate += (oldWidth + newWidth) / 2 + m_levelDistance;
-		for(it = newLevel.begin(); it.valid(); it = it.succ())
-			AG.x(*it) = xCoordinate;
+		if(nChunks > 1) {
+			forEachInParallel(nChunks, nChunks, [&](int c) {
+				int chunkEnd = min(end, begin + (c+1) * chunkSize);
+				for(int k2 = begin + c * chunkSize; k2 < chunkEnd; ++k2)
+					AG.x(ts.m_node[order[k2]]) = xCoordinate;
+			});
+		} else {
+			for(int k2 = begin; k2 < end; ++k2)
+				AG.x(ts.m_node[order[k2]]) = xCoordinate;
+		}
 	}
 }
 
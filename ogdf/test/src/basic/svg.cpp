@@ -247,6 +247,46 @@ describe("SVG", []() {
 
 		AssertThat(static_cast<int>(doc.select_nodes(".//polygon").size()), Equals(graph->numberOfEdges() * 2));
 	});
+
+	it("streams the same output as the document", [&]() {
+		ClusterGraph clusterGraph(*graph);
+		randomClusterGraph(clusterGraph, *graph, 5);
+		ClusterGraphAttributes attr(clusterGraph,
+				GraphAttributes::nodeGraphics |
+				GraphAttributes::nodeStyle |
+				GraphAttributes::nodeLabel |
+				GraphAttributes::edgeGraphics |
+				GraphAttributes::edgeStyle |
+				GraphAttributes::edgeLabel |
+				GraphAttributes::edgeArrow);
+
+		int i = 0;
+		for(node v : graph->nodes) {
+			attr.x(v) = randomDouble(0, 1000);
+			attr.y(v) = randomDouble(0, 1000);
+			attr.shape(v) = static_cast<Shape>(i % 13);
+			attr.label(v) = to_string(i++) + " <&\"\n>";
+			attr.fillColor(v) = Color::Name::Red;
+		}
+
+		for(edge e : graph->edges) {
+			attr.label(e) = to_string(e->index());
+			attr.arrowType(e) = static_cast<EdgeArrow>(e->index() % 5);
+			attr.strokeType(e) = static_cast<StrokeType>(e->index() % 6);
+			attr.bends(e).pushBack(DPoint(randomDouble(0, 1000), randomDouble(0, 1000)));
+		}
+
+		GraphIO::SVGSettings settings;
+		settings.width("100%");
+		settings.curviness(0.3);
+
+		std::ostringstream document, stream;
+		GraphIO::drawSVG(attr, document, settings);
+		settings.streaming(true);
+		GraphIO::drawSVG(attr, stream, settings);
+
+		AssertThat(stream.str(), Equals(document.str()));
+	});
 });
 });
 });